@@ -0,0 +1,97 @@
+#!/bin/sh
+#
+# Compares the metrics written by hd-status-bench --metrics or by
+# run-callgrind.sh with a baseline. All metrics are lower is better; a
+# metric regresses when it exceeds its baseline by more than the
+# tolerance in percent, TIME_TOLERANCE for the _ms metrics and
+# TOLERANCE for the counts.
+# Metrics missing from the baseline, an empty baseline and lines that
+# are not a metric with a plain non-negative number fail the check.
+# REFRESH_TARGET names the make target which writes the baseline.
+# GATED_METRICS, an awk regular expression, limits the check to the
+# matching metrics, the others are only reported.
+#
+# Usage: compare-perf.sh BASELINE CURRENT [TOLERANCE [TIME_TOLERANCE]]
+
+set -e
+
+baseline="$1"
+current="$2"
+tolerance=${3:-10}
+time_tolerance=${4:-25}
+refresh=${REFRESH_TARGET:-refresh-perf-baseline}
+gated=${GATED_METRICS:-.}
+
+if [ ! -f "$baseline" ]; then
+  echo "No baseline $baseline, run make $refresh" >&2
+  exit 1
+fi
+
+awk -v tolerance=$tolerance -v time_tolerance=$time_tolerance \
+    -v baseline="$baseline" -v refresh="$refresh" -v gated="$gated" '
+  # Sets key and value from a line "key": value, returns 0 for lines
+  # without a key, e.g. the braces
+  function parse(line) {
+    if (line !~ /"/)
+      return 0
+    if (line !~ /^[ \t]*"[a-z0-9_]+":[ \t]*[0-9]+(\.[0-9]+)?[ \t]*,?[ \t]*$/) {
+      printf "%s:%d: not a metric: %s\n", FILENAME, FNR, line > "/dev/stderr"
+      malformed++
+      return 0
+    }
+    key = line
+    sub (/^[ \t]*"/, "", key)
+    sub (/".*/, "", key)
+    value = line
+    sub (/.*:[ \t]*/, "", value)
+    sub (/[ \t]*,?[ \t]*$/, "", value)
+    return 1
+  }
+
+  FNR == NR { if (parse($0)) { base[key] = value + 0; n_base++ } next }
+
+  parse($0) {
+    keys[++n] = key
+    cur[key] = value + 0
+  }
+
+  END {
+    if (malformed)
+      exit 1
+    if (!n_base) {
+      printf "Baseline %s is empty, run make %s\n", baseline, refresh > "/dev/stderr"
+      exit 1
+    }
+    if (!n) {
+      printf "No metrics in %s\n", FILENAME > "/dev/stderr"
+      exit 1
+    }
+    printf "%-32s %12s %12s %9s\n", "metric", "baseline", "current", "change"
+    for (i = 1; i <= n; i++) {
+      k = keys[i]
+      if (k !~ gated) {
+        printf "%-32s %12s %12.3f %9s  not gated\n", k, "-", cur[k], "-"
+        continue
+      }
+      if (!(k in base)) {
+        printf "%-32s %12s %12.3f %9s  NOT IN BASELINE\n", k, "-", cur[k], "-"
+        missing++
+        continue
+      }
+      limit = (k ~ /_ms$/) ? time_tolerance : tolerance
+      change = base[k] ? (cur[k] - base[k]) * 100 / base[k] : (cur[k] > 0 ? 100 : 0)
+      status = ""
+      if (cur[k] > base[k] * (1 + limit / 100) && cur[k] > base[k]) {
+        status = "REGRESSED (tolerance " limit "%)"
+        failed++
+      }
+      printf "%-32s %12.3f %12.3f %8.1f%%  %s\n", k, base[k], cur[k], change, status
+    }
+    if (missing)
+      printf "%d metric(s) not in the baseline, run make %s\n", missing, refresh
+    if (failed)
+      printf "%d metric(s) regressed\n", failed
+    if (missing || failed)
+      exit 1
+  }
+' "$baseline" "$current"
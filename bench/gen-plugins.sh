@@ -0,0 +1,55 @@
+#!/bin/sh
+#
+# Writes N synthetic status menu plugins: the .desktop entries, a
+# status-menu.plugins with varied positions and a status-menu.conf
+# which loads them from DIR.
+#
+# Usage: gen-plugins.sh N DIR MODULE
+#   MODULE is the absolute path of hd-bench-status-plugin.so
+
+set -e
+
+n="$1"
+dir="$2"
+module="$3"
+
+if [ -z "$n" ] || [ -z "$dir" ] || [ -z "$module" ]; then
+  echo "Usage: $0 N DIR MODULE" >&2
+  exit 1
+fi
+
+rm -rf "$dir"
+mkdir -p "$dir/plugins"
+
+cat > "$dir/status-menu.conf" <<EOC
+[X-PluginManager]
+X-Plugin-Dir=$dir/plugins
+X-Load-New-Plugins=true
+X-Load-All-Plugins=true
+X-Plugin-Configuration=status-menu.plugins
+EOC
+
+# Positions are permutations of 0..N-1 so packing order differs from
+# load order. Every third plugin is menu only, every fifth has no menu
+# position and every seventh has no status area position.
+awk -v n="$n" -v dir="$dir" -v module="$module" 'BEGIN {
+  for (i = 0; i < n; i++)
+    {
+      id = sprintf ("hd-bench-%04d.desktop", i);
+
+      desktop = dir "/plugins/" id;
+      print "[Desktop Entry]" > desktop;
+      print "Name=Benchmark plugin " i > desktop;
+      print "Type=default" > desktop;
+      print "X-Path=" module > desktop;
+      close (desktop);
+
+      print "[" id "]";
+      print "X-Desktop-File=" desktop;
+      if (i % 3 != 0 && i % 7 != 0)
+        print "X-Status-Area-Position=" (i * 7919) % n;
+      if (i % 5 != 0)
+        print "X-Status-Menu-Position=" (i * 104729) % n;
+      print "";
+    }
+}' > "$dir/status-menu.plugins"
@@ -0,0 +1,267 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/* Compares the cost per frame of a status area icon animated through
+ * the status-area-icon property with the native status area animation,
+ * and checks that the animation does not tick while the status area is
+ * off screen. Fails when the native animation is not cheaper or keeps
+ * ticking. Use run-bench.sh to get a private X server and D-Bus buses. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <libhildondesktop/libhildondesktop.h>
+#include <hildon/hildon.h>
+
+#include "hd-bench.h"
+#include "hd-bench-plugin.h"
+#include "hd-plugin-stats.h"
+#include "hd-status-area.h"
+#include "hd-status-menu-config.h"
+
+#define PLUGIN_ID "hd-bench-plugin-0.desktop"
+
+static gint interval = 40;
+static gint duration = 3;
+static gchar *output = NULL;
+
+static GOptionEntry entries[] =
+{
+  { "interval", 'i', 0, G_OPTION_ARG_INT, &interval, "Frame interval in milliseconds", "MS" },
+  { "duration", 'd', 0, G_OPTION_ARG_INT, &duration, "Duration of each phase in seconds", "S" },
+  { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "Write the JSON report to FILE", "FILE" },
+  { NULL }
+};
+
+typedef struct _HDAnimationPhase HDAnimationPhase;
+struct _HDAnimationPhase
+{
+  guint   frames;
+  gdouble cpu_ms;
+  gulong  x_requests;
+};
+
+static GMainLoop *loop = NULL;
+
+static gboolean
+quit_cb (gpointer data)
+{
+  g_main_loop_quit (loop);
+
+  return FALSE;
+}
+
+static void
+run_for (guint ms)
+{
+  g_timeout_add (ms, quit_cb, NULL);
+  g_main_loop_run (loop);
+  hd_bench_flush ();
+}
+
+static gboolean
+icon_frame_cb (HDBenchPlugin *plugin)
+{
+  hd_bench_plugin_update_icon (plugin);
+
+  return TRUE;
+}
+
+static void
+phase_begin (HDAnimationPhase *phase)
+{
+  gdouble user_ms, system_ms;
+
+  hd_bench_get_cpu_time (&user_ms, &system_ms);
+  phase->cpu_ms = -(user_ms + system_ms);
+  phase->x_requests = hd_bench_get_x_requests ();
+}
+
+static void
+phase_end (HDAnimationPhase *phase)
+{
+  gdouble user_ms, system_ms;
+
+  hd_bench_get_cpu_time (&user_ms, &system_ms);
+  phase->cpu_ms += user_ms + system_ms;
+  phase->x_requests = hd_bench_get_x_requests () - phase->x_requests;
+}
+
+static gdouble
+phase_cpu_ms_per_frame (HDAnimationPhase *phase)
+{
+  return phase->frames ? phase->cpu_ms / phase->frames : 0.0;
+}
+
+static gdouble
+phase_x_requests_per_frame (HDAnimationPhase *phase)
+{
+  return phase->frames ? (gdouble) phase->x_requests / phase->frames : 0.0;
+}
+
+static void
+write_phase_json (const gchar      *name,
+                  HDAnimationPhase *phase,
+                  FILE             *file)
+{
+  fprintf (file, "    \"%s\": { \"frames\": %u, \"cpu_ms_per_frame\": %.4f, "
+           "\"x_requests_per_frame\": %.2f }",
+           name, phase->frames,
+           phase_cpu_ms_per_frame (phase),
+           phase_x_requests_per_frame (phase));
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  HDPluginManager *plugin_manager;
+  GKeyFile *keyfile;
+  GtkWidget *status_area, *plugin;
+  HDPluginStats *stats;
+  HDAnimationPhase property = { 0, }, animation = { 0, };
+  guint source_id, hidden_ticks;
+  FILE *file = stdout;
+  gboolean ok = TRUE;
+
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
+  context = g_option_context_new ("- benchmark animated status area icons");
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_group (context, gtk_get_option_group (TRUE));
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (context);
+
+  interval = MAX (interval, 1);
+  duration = MAX (duration, 1);
+
+  hildon_init ();
+
+  loop = g_main_loop_new (NULL, FALSE);
+
+  /* A plugin manager without plugins, the synthetic plugin is added by
+   * emitting its signal */
+  plugin_manager = hd_plugin_manager_new (hd_config_file_new (g_get_tmp_dir (),
+                                                              NULL,
+                                                              "hd-animation-bench.conf"));
+
+  keyfile = g_key_file_new ();
+  g_key_file_set_integer (keyfile, PLUGIN_ID,
+                          HD_STATUS_AREA_CONFIG_KEY_POSITION, 0);
+  hd_status_menu_config_load (keyfile);
+
+  status_area = hd_status_area_new (plugin_manager);
+  gtk_widget_show (status_area);
+
+  plugin = g_object_ref_sink (hd_bench_plugin_new (PLUGIN_ID));
+  hd_plugin_stats_register (G_OBJECT (plugin));
+  g_signal_emit_by_name (plugin_manager, "plugin-added", plugin);
+  hd_bench_plugin_update_icon (HD_BENCH_PLUGIN (plugin));
+  stats = hd_plugin_stats_lookup (plugin);
+
+  run_for (500);
+
+  /* Every frame changes the status-area-icon property */
+  phase_begin (&property);
+  property.frames = stats->icon_updates;
+  source_id = g_timeout_add (interval, (GSourceFunc) icon_frame_cb, plugin);
+  run_for (duration * 1000);
+  g_source_remove (source_id);
+  property.frames = stats->icon_updates - property.frames;
+  phase_end (&property);
+
+  /* The same frames with the native animation, the frames are counted
+   * by the dispatches of the animation ticks */
+  phase_begin (&animation);
+  animation.frames = stats->dispatches;
+  hd_bench_plugin_start_animation (HD_BENCH_PLUGIN (plugin), interval);
+  run_for (duration * 1000);
+  animation.frames = stats->dispatches - animation.frames;
+  phase_end (&animation);
+
+  /* The status area checks whether it is on screen on configure events,
+   * the compositor moves it away to hide it */
+  gtk_window_move (GTK_WINDOW (status_area), -1000, 0);
+  run_for (100);
+  hidden_ticks = stats->dispatches;
+  run_for (10 * interval);
+  hidden_ticks = stats->dispatches - hidden_ticks;
+
+  hd_bench_plugin_stop_animation (HD_BENCH_PLUGIN (plugin));
+
+  if (output)
+    {
+      file = fopen (output, "w");
+      if (!file)
+        {
+          g_printerr ("Could not open %s\n", output);
+          return 1;
+        }
+    }
+
+  fprintf (file, "{\n");
+  fprintf (file, "  \"benchmark\": \"animation\",\n");
+  fprintf (file, "  \"config\": { \"interval\": %d, \"duration\": %d },\n",
+           interval, duration);
+  fprintf (file, "  \"phases\": {\n");
+  write_phase_json ("property", &property, file);
+  fprintf (file, ",\n");
+  write_phase_json ("animation", &animation, file);
+  fprintf (file, "\n  },\n");
+  fprintf (file, "  \"hidden_ticks\": %u\n", hidden_ticks);
+  fprintf (file, "}\n");
+
+  if (file != stdout)
+    fclose (file);
+
+  if (!animation.frames ||
+      phase_cpu_ms_per_frame (&animation) >= phase_cpu_ms_per_frame (&property))
+    {
+      g_printerr ("animation: %.4f CPU ms per frame over %u frames, "
+                  "%.4f with the status-area-icon property\n",
+                  phase_cpu_ms_per_frame (&animation), animation.frames,
+                  phase_cpu_ms_per_frame (&property));
+      ok = FALSE;
+    }
+
+  if (hidden_ticks)
+    {
+      g_printerr ("animation: %u frames drawn while the status area was off screen\n",
+                  hidden_ticks);
+      ok = FALSE;
+    }
+
+  g_signal_emit_by_name (plugin_manager, "plugin-removed", plugin);
+  hd_plugin_stats_unregister (G_OBJECT (plugin));
+  g_object_unref (plugin);
+  gtk_widget_destroy (status_area);
+  g_key_file_free (keyfile);
+
+  return ok ? 0 : 2;
+}
@@ -0,0 +1,142 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "hd-bench-plugin.h"
+#include "hd-status-area.h"
+
+#define HD_BENCH_PLUGIN_GET_PRIVATE(object) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((object), HD_TYPE_BENCH_PLUGIN, HDBenchPluginPrivate))
+
+/* Size of status area icons */
+#define ICON_WIDTH  18
+#define ICON_HEIGHT 36
+
+#define N_ICONS 2
+
+struct _HDBenchPluginPrivate
+{
+  GdkPixbuf *icons[N_ICONS];
+  guint      current_icon;
+};
+
+G_DEFINE_TYPE (HDBenchPlugin, hd_bench_plugin, HD_TYPE_STATUS_PLUGIN_ITEM);
+
+static void
+hd_bench_plugin_init (HDBenchPlugin *plugin)
+{
+  HDBenchPluginPrivate *priv = HD_BENCH_PLUGIN_GET_PRIVATE (plugin);
+  GtkWidget *button;
+  guint i;
+
+  plugin->priv = priv;
+
+  /* Different colors, so each update changes the pixels */
+  for (i = 0; i < N_ICONS; i++)
+    {
+      priv->icons[i] = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8,
+                                       ICON_WIDTH, ICON_HEIGHT);
+      gdk_pixbuf_fill (priv->icons[i], i ? 0xffffffff : 0x3060c0ff);
+    }
+
+  button = gtk_button_new_with_label ("Benchmark item");
+  gtk_widget_show (button);
+  gtk_container_add (GTK_CONTAINER (plugin), button);
+}
+
+static void
+hd_bench_plugin_dispose (GObject *object)
+{
+  HDBenchPluginPrivate *priv = HD_BENCH_PLUGIN (object)->priv;
+  guint i;
+
+  for (i = 0; i < N_ICONS; i++)
+    if (priv->icons[i])
+      priv->icons[i] = (g_object_unref (priv->icons[i]), NULL);
+
+  G_OBJECT_CLASS (hd_bench_plugin_parent_class)->dispose (object);
+}
+
+static void
+hd_bench_plugin_class_init (HDBenchPluginClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = hd_bench_plugin_dispose;
+
+  g_type_class_add_private (klass, sizeof (HDBenchPluginPrivate));
+}
+
+GtkWidget *
+hd_bench_plugin_new (const gchar *plugin_id)
+{
+  return g_object_new (HD_TYPE_BENCH_PLUGIN,
+                       "plugin-id", plugin_id,
+                       NULL);
+}
+
+void
+hd_bench_plugin_update_icon (HDBenchPlugin *plugin)
+{
+  HDBenchPluginPrivate *priv = plugin->priv;
+
+  priv->current_icon = (priv->current_icon + 1) % N_ICONS;
+
+  hd_status_plugin_item_set_status_area_icon (HD_STATUS_PLUGIN_ITEM (plugin),
+                                              priv->icons[priv->current_icon]);
+}
+
+/* Shows or hides the menu item, which changes the menu layout */
+void
+hd_bench_plugin_toggle_visible (HDBenchPlugin *plugin)
+{
+  if (GTK_WIDGET_VISIBLE (plugin))
+    gtk_widget_hide (GTK_WIDGET (plugin));
+  else
+    gtk_widget_show (GTK_WIDGET (plugin));
+}
+
+/* Flips between the icons with the native status area animation */
+void
+hd_bench_plugin_start_animation (HDBenchPlugin *plugin,
+                                 guint          interval)
+{
+  HDBenchPluginPrivate *priv = plugin->priv;
+  GList *frames = NULL;
+  guint i;
+
+  for (i = N_ICONS; i > 0; i--)
+    frames = g_list_prepend (frames, priv->icons[i - 1]);
+
+  HD_STATUS_AREA_START_ANIMATION (plugin, interval, frames);
+
+  g_list_free (frames);
+}
+
+void
+hd_bench_plugin_stop_animation (HDBenchPlugin *plugin)
+{
+  HD_STATUS_AREA_STOP_ANIMATION (plugin);
+}
@@ -0,0 +1,66 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef __HD_BENCH_PLUGIN_H__
+#define __HD_BENCH_PLUGIN_H__
+
+#include <libhildondesktop/libhildondesktop.h>
+
+G_BEGIN_DECLS
+
+#define HD_TYPE_BENCH_PLUGIN            (hd_bench_plugin_get_type ())
+#define HD_BENCH_PLUGIN(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), HD_TYPE_BENCH_PLUGIN, HDBenchPlugin))
+#define HD_BENCH_PLUGIN_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), HD_TYPE_BENCH_PLUGIN, HDBenchPluginClass))
+#define HD_IS_BENCH_PLUGIN(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), HD_TYPE_BENCH_PLUGIN))
+#define HD_IS_BENCH_PLUGIN_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), HD_TYPE_BENCH_PLUGIN))
+#define HD_BENCH_PLUGIN_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), HD_TYPE_BENCH_PLUGIN, HDBenchPluginClass))
+
+typedef struct _HDBenchPlugin        HDBenchPlugin;
+typedef struct _HDBenchPluginClass   HDBenchPluginClass;
+typedef struct _HDBenchPluginPrivate HDBenchPluginPrivate;
+
+/* Synthetic status plugin with a status area icon and a menu item */
+struct _HDBenchPlugin
+{
+  HDStatusPluginItem parent;
+
+  HDBenchPluginPrivate *priv;
+};
+
+struct _HDBenchPluginClass
+{
+  HDStatusPluginItemClass parent;
+};
+
+GType      hd_bench_plugin_get_type         (void);
+
+GtkWidget *hd_bench_plugin_new              (const gchar   *plugin_id);
+
+void       hd_bench_plugin_update_icon      (HDBenchPlugin *plugin);
+void       hd_bench_plugin_toggle_visible   (HDBenchPlugin *plugin);
+void       hd_bench_plugin_start_animation  (HDBenchPlugin *plugin,
+                                             guint          interval);
+void       hd_bench_plugin_stop_animation   (HDBenchPlugin *plugin);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/* Loadable status plugin for the scaling benchmark, every generated
+ * .desktop entry points to this module */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <libhildondesktop/libhildondesktop.h>
+
+typedef struct _HDBenchStatusPlugin      HDBenchStatusPlugin;
+typedef struct _HDBenchStatusPluginClass HDBenchStatusPluginClass;
+
+struct _HDBenchStatusPlugin
+{
+  HDStatusPluginItem parent;
+};
+
+struct _HDBenchStatusPluginClass
+{
+  HDStatusPluginItemClass parent;
+};
+
+HD_DEFINE_PLUGIN_MODULE (HDBenchStatusPlugin, hd_bench_status_plugin, HD_TYPE_STATUS_PLUGIN_ITEM);
+
+/* Size of status area icons */
+#define ICON_WIDTH  18
+#define ICON_HEIGHT 36
+
+static void
+hd_bench_status_plugin_init (HDBenchStatusPlugin *plugin)
+{
+  GtkWidget *button;
+  GdkPixbuf *icon;
+
+  icon = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8,
+                         ICON_WIDTH, ICON_HEIGHT);
+  gdk_pixbuf_fill (icon, 0x3060c0ff);
+  hd_status_plugin_item_set_status_area_icon (HD_STATUS_PLUGIN_ITEM (plugin),
+                                              icon);
+  g_object_unref (icon);
+
+  button = gtk_button_new_with_label ("Benchmark item");
+  gtk_widget_show (button);
+  gtk_container_add (GTK_CONTAINER (plugin), button);
+
+  gtk_widget_show (GTK_WIDGET (plugin));
+}
+
+static void
+hd_bench_status_plugin_class_init (HDBenchStatusPluginClass *klass)
+{
+}
+
+static void
+hd_bench_status_plugin_class_finalize (HDBenchStatusPluginClass *klass)
+{
+}
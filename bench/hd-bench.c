@@ -0,0 +1,452 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtk/gtk.h>
+#include <gdk/gdkx.h>
+
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "hd-bench.h"
+#include "hd-status-area-box.h"
+#include "hd-status-menu.h"
+#include "hd-status-menu-box.h"
+#include "hd-x-stats.h"
+
+/* Updated from any thread */
+static volatile gint allocations = 0;
+
+static guint layout_passes = 0;
+
+HDBenchSeries *
+hd_bench_series_new (const gchar *name)
+{
+  HDBenchSeries *series = g_slice_new0 (HDBenchSeries);
+
+  series->name = g_strdup (name);
+  series->samples = g_array_new (FALSE, FALSE, sizeof (gdouble));
+
+  return series;
+}
+
+void
+hd_bench_series_free (HDBenchSeries *series)
+{
+  g_free (series->name);
+  g_array_free (series->samples, TRUE);
+  g_slice_free (HDBenchSeries, series);
+}
+
+/**
+ * hd_bench_series_begin:
+ * @series: a #HDBenchSeries
+ *
+ * Starts measuring one operation, which ends with
+ * hd_bench_series_end().
+ **/
+void
+hd_bench_series_begin (HDBenchSeries *series)
+{
+  HDXStats totals;
+
+  hd_x_stats_get_totals (&totals);
+  series->start_round_trips = totals.round_trips;
+  series->start_allocations = hd_bench_get_allocations ();
+  series->start_layout_passes = layout_passes;
+
+  series->start_request = hd_bench_get_x_requests ();
+  series->start = hd_bench_get_time_us ();
+}
+
+/**
+ * hd_bench_series_end:
+ * @series: a #HDBenchSeries
+ *
+ * Handles all pending events and waits for the X server to process the
+ * requests of the operation, then adds its latency to @series.
+ **/
+void
+hd_bench_series_end (HDBenchSeries *series)
+{
+  HDXStats totals;
+  gulong requests;
+
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+  gdk_window_process_all_updates ();
+
+  /* The XSync of the flush is not part of the operation */
+  requests = hd_bench_get_x_requests () - series->start_request;
+
+  hd_x_stats_get_totals (&totals);
+  series->round_trips += totals.round_trips - series->start_round_trips;
+  series->allocations += hd_bench_get_allocations () - series->start_allocations;
+  series->layout_passes += layout_passes - series->start_layout_passes;
+
+  hd_bench_flush ();
+
+  hd_bench_series_add (series,
+                       (hd_bench_get_time_us () - series->start) / 1000.0,
+                       requests);
+}
+
+void
+hd_bench_series_add (HDBenchSeries *series,
+                     gdouble        ms,
+                     gulong         x_requests)
+{
+  g_array_append_val (series->samples, ms);
+  series->x_requests += x_requests;
+}
+
+static gint
+compare_double (gconstpointer a,
+                gconstpointer b)
+{
+  gdouble da = *(const gdouble *) a, db = *(const gdouble *) b;
+
+  return da < db ? -1 : da > db;
+}
+
+/* Nearest rank, the samples are sorted in place */
+gdouble
+hd_bench_series_percentile (HDBenchSeries *series,
+                            gdouble        percentile)
+{
+  guint rank;
+
+  if (!series->samples->len)
+    return 0.0;
+
+  g_array_sort (series->samples, compare_double);
+
+  rank = (guint) (percentile / 100.0 * series->samples->len + 0.5);
+  rank = CLAMP (rank, 1, series->samples->len);
+
+  return g_array_index (series->samples, gdouble, rank - 1);
+}
+
+gdouble
+hd_bench_series_mean (HDBenchSeries *series)
+{
+  gdouble sum = 0.0;
+  guint i;
+
+  if (!series->samples->len)
+    return 0.0;
+
+  for (i = 0; i < series->samples->len; i++)
+    sum += g_array_index (series->samples, gdouble, i);
+
+  return sum / series->samples->len;
+}
+
+gdouble
+hd_bench_series_round_trips_per_op (HDBenchSeries *series)
+{
+  guint count = series->samples->len;
+
+  return count ? (gdouble) series->round_trips / count : 0.0;
+}
+
+gdouble
+hd_bench_series_allocations_per_op (HDBenchSeries *series)
+{
+  guint count = series->samples->len;
+
+  return count ? (gdouble) series->allocations / count : 0.0;
+}
+
+gdouble
+hd_bench_series_layout_passes_per_op (HDBenchSeries *series)
+{
+  guint count = series->samples->len;
+
+  return count ? (gdouble) series->layout_passes / count : 0.0;
+}
+
+/* Writes the series as a JSON member, without separator */
+void
+hd_bench_series_write_json (HDBenchSeries *series,
+                            FILE          *file)
+{
+  guint count = series->samples->len;
+
+  fprintf (file,
+           "    \"%s\": { \"count\": %u, \"mean_ms\": %.3f, "
+           "\"p50_ms\": %.3f, \"p90_ms\": %.3f, \"p99_ms\": %.3f, "
+           "\"max_ms\": %.3f, \"x_requests_per_op\": %.1f, "
+           "\"round_trips_per_op\": %.2f, \"allocations_per_op\": %.1f, "
+           "\"layout_passes_per_op\": %.2f }",
+           series->name,
+           count,
+           hd_bench_series_mean (series),
+           hd_bench_series_percentile (series, 50),
+           hd_bench_series_percentile (series, 90),
+           hd_bench_series_percentile (series, 99),
+           hd_bench_series_percentile (series, 100),
+           count ? (gdouble) series->x_requests / count : 0.0,
+           hd_bench_series_round_trips_per_op (series),
+           hd_bench_series_allocations_per_op (series),
+           hd_bench_series_layout_passes_per_op (series));
+}
+
+typedef struct
+{
+  FILE     *file;
+  gboolean  first;
+} WriteXPathData;
+
+static void
+write_x_path_json (gpointer        key,
+                   gpointer        value,
+                   WriteXPathData *data)
+{
+  HDXStats *stats = value;
+
+  fprintf (data->file,
+           "%s    \"%s\": { \"calls\": %u, \"requests\": %lu, \"round_trips\": %u }",
+           data->first ? "" : ",\n",
+           (const gchar *) key,
+           stats->calls,
+           stats->requests,
+           stats->round_trips);
+
+  data->first = FALSE;
+}
+
+/* Writes the X traffic of the instrumented paths as a JSON member,
+ * without separator */
+void
+hd_bench_write_x_paths_json (FILE *file)
+{
+  WriteXPathData data = { file, TRUE };
+
+  fprintf (file, "  \"x_paths\": {\n");
+  hd_x_stats_foreach ((GHFunc) write_x_path_json, &data);
+  fprintf (file, "%s  }", data.first ? "" : "\n");
+}
+
+gint64
+hd_bench_get_time_us (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+gint64
+hd_bench_get_time_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Requests sent on the default display so far */
+gulong
+hd_bench_get_x_requests (void)
+{
+  return XNextRequest (GDK_DISPLAY_XDISPLAY (gdk_display_get_default ()));
+}
+
+void
+hd_bench_get_cpu_time (gdouble *user_ms,
+                       gdouble *system_ms)
+{
+  struct rusage usage;
+
+  getrusage (RUSAGE_SELF, &usage);
+
+  *user_ms = usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0;
+  *system_ms = usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0;
+}
+
+/* Waits until the X server processed all requests */
+void
+hd_bench_flush (void)
+{
+  gdk_display_sync (gdk_display_get_default ());
+}
+
+static gpointer
+counting_malloc (gsize n_bytes)
+{
+  g_atomic_int_inc (&allocations);
+
+  return malloc (n_bytes);
+}
+
+static gpointer
+counting_realloc (gpointer mem,
+                  gsize    n_bytes)
+{
+  g_atomic_int_inc (&allocations);
+
+  return realloc (mem, n_bytes);
+}
+
+static gpointer
+counting_calloc (gsize n_blocks,
+                 gsize n_block_bytes)
+{
+  g_atomic_int_inc (&allocations);
+
+  return calloc (n_blocks, n_block_bytes);
+}
+
+/**
+ * hd_bench_count_allocations:
+ *
+ * Counts the g_malloc () family of calls from now on. Must be called
+ * before anything else in main (), glib refuses to change the
+ * allocator after the first allocation. GSlice keeps its own
+ * magazines, so only its refills are counted.
+ **/
+void
+hd_bench_count_allocations (void)
+{
+  static GMemVTable vtable =
+  {
+    counting_malloc,
+    counting_realloc,
+    free,
+    counting_calloc,
+    counting_malloc,
+    counting_realloc
+  };
+
+  g_mem_set_vtable (&vtable);
+}
+
+guint
+hd_bench_get_allocations (void)
+{
+  return g_atomic_int_get (&allocations);
+}
+
+static gboolean
+size_allocate_hook (GSignalInvocationHint *ihint,
+                    guint                  n_param_values,
+                    const GValue          *param_values,
+                    gpointer               data)
+{
+  GObject *object = g_value_get_object (&param_values[0]);
+
+  if (HD_IS_STATUS_AREA_BOX (object) || HD_IS_STATUS_MENU_BOX (object))
+    layout_passes++;
+
+  return TRUE;
+}
+
+/**
+ * hd_bench_count_layout_passes:
+ *
+ * Counts the size allocations of the status area and status menu
+ * boxes from now on.
+ **/
+void
+hd_bench_count_layout_passes (void)
+{
+  g_signal_add_emission_hook (g_signal_lookup ("size-allocate", GTK_TYPE_WIDGET),
+                              0, size_allocate_hook, NULL, NULL);
+}
+
+guint
+hd_bench_get_layout_passes (void)
+{
+  return layout_passes;
+}
+
+typedef struct
+{
+  GType      type;
+  GtkWidget *found;
+} FindWidgetData;
+
+static void
+find_widget_cb (GtkWidget      *widget,
+                FindWidgetData *data)
+{
+  if (!data->found)
+    data->found = hd_bench_find_widget (widget, data->type);
+}
+
+/* Depth first search for a widget of @type below @root */
+GtkWidget *
+hd_bench_find_widget (GtkWidget *root,
+                      GType      type)
+{
+  FindWidgetData data = { type, NULL };
+
+  if (G_TYPE_CHECK_INSTANCE_TYPE (root, type))
+    return root;
+
+  if (GTK_IS_CONTAINER (root))
+    gtk_container_forall (GTK_CONTAINER (root),
+                          (GtkCallback) find_widget_cb,
+                          &data);
+
+  return data.found;
+}
+
+GtkWidget *
+hd_bench_find_status_menu (void)
+{
+  GList *toplevels, *t;
+  GtkWidget *status_menu = NULL;
+
+  toplevels = gtk_window_list_toplevels ();
+  for (t = toplevels; t; t = t->next)
+    if (HD_IS_STATUS_MENU (t->data))
+      status_menu = t->data;
+  g_list_free (toplevels);
+
+  return status_menu;
+}
+
+/* The status area opens the menu on button release */
+void
+hd_bench_open_status_menu (GtkWidget *status_area)
+{
+  GdkEvent *event;
+  gboolean handled;
+
+  event = gdk_event_new (GDK_BUTTON_RELEASE);
+  event->button.window = g_object_ref (status_area->window);
+  event->button.button = 1;
+  event->button.time = GDK_CURRENT_TIME;
+
+  g_signal_emit_by_name (status_area, "button-release-event",
+                         event, &handled);
+
+  gdk_event_free (event);
+}
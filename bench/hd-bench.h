@@ -0,0 +1,99 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef __HD_BENCH_H__
+#define __HD_BENCH_H__
+
+#include <gtk/gtk.h>
+
+#include <stdio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _HDBenchSeries HDBenchSeries;
+
+/* Latencies of one kind of operation */
+struct _HDBenchSeries
+{
+  gchar  *name;
+
+  GArray *samples;      /* gdouble ms */
+  gulong  x_requests;
+  guint   round_trips;  /* of the instrumented X paths */
+  guint   allocations;
+  guint   layout_passes;
+
+  /* set by hd_bench_series_begin () */
+  gint64  start;
+  gulong  start_request;
+  guint   start_round_trips;
+  guint   start_allocations;
+  guint   start_layout_passes;
+};
+
+HDBenchSeries *hd_bench_series_new        (const gchar   *name);
+void           hd_bench_series_free       (HDBenchSeries *series);
+
+void           hd_bench_series_begin      (HDBenchSeries *series);
+void           hd_bench_series_end        (HDBenchSeries *series);
+void           hd_bench_series_add        (HDBenchSeries *series,
+                                           gdouble        ms,
+                                           gulong         x_requests);
+
+gdouble        hd_bench_series_percentile (HDBenchSeries *series,
+                                           gdouble        percentile);
+gdouble        hd_bench_series_mean       (HDBenchSeries *series);
+gdouble        hd_bench_series_round_trips_per_op
+                                          (HDBenchSeries *series);
+gdouble        hd_bench_series_allocations_per_op
+                                          (HDBenchSeries *series);
+gdouble        hd_bench_series_layout_passes_per_op
+                                          (HDBenchSeries *series);
+
+void           hd_bench_series_write_json (HDBenchSeries *series,
+                                           FILE          *file);
+
+gint64         hd_bench_get_time_us       (void);
+gint64         hd_bench_get_time_ns       (void);
+gulong         hd_bench_get_x_requests    (void);
+void           hd_bench_get_cpu_time      (gdouble       *user_ms,
+                                           gdouble       *system_ms);
+
+void           hd_bench_flush             (void);
+
+void           hd_bench_count_allocations (void);
+guint          hd_bench_get_allocations   (void);
+void           hd_bench_count_layout_passes
+                                          (void);
+guint          hd_bench_get_layout_passes (void);
+
+void           hd_bench_write_x_paths_json
+                                          (FILE          *file);
+
+GtkWidget     *hd_bench_find_widget       (GtkWidget     *root,
+                                           GType          type);
+GtkWidget     *hd_bench_find_status_menu  (void);
+void           hd_bench_open_status_menu  (GtkWidget     *status_area);
+
+G_END_DECLS
+
+#endif
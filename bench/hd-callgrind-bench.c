@@ -0,0 +1,308 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/* Runs one scenario of the status area and menu deterministically, to
+ * be counted by callgrind: no timers, a fixed number of iterations,
+ * and collection switched on only around the measured part. Use
+ * run-callgrind.sh, which runs every scenario under valgrind and
+ * extracts the instruction counts and simulated cache misses. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <libhildondesktop/libhildondesktop.h>
+#include <hildon/hildon.h>
+
+#include <string.h>
+
+/* Without the client requests nothing would be collected and every
+ * metric would be 0 */
+#ifdef HAVE_VALGRIND_CALLGRIND_H
+#include <valgrind/callgrind.h>
+#else
+#error "hd-callgrind-bench needs valgrind/callgrind.h, install the valgrind headers and run configure again"
+#endif
+
+#include "hd-bench.h"
+#include "hd-bench-plugin.h"
+#include "hd-status-area.h"
+#include "hd-status-menu.h"
+#include "hd-status-menu-config.h"
+
+static gint n_plugins = 20;
+static gint iterations = 50;
+static gchar *scenario = NULL;
+
+static GOptionEntry entries[] =
+{
+  { "scenario", 's', 0, G_OPTION_ARG_STRING, &scenario,
+    "plugin-load, icon-burst, visibility-flip, rotation or menu", "NAME" },
+  { "plugins", 'n', 0, G_OPTION_ARG_INT, &n_plugins, "Number of synthetic plugins", "N" },
+  { "iterations", 'i', 0, G_OPTION_ARG_INT, &iterations, "Repetitions of the measured operation", "N" },
+  { NULL }
+};
+
+typedef struct _HDCallgrindBench HDCallgrindBench;
+struct _HDCallgrindBench
+{
+  HDPluginManager *plugin_manager;
+  GtkWidget       *status_area;
+  GPtrArray       *plugins;
+};
+
+typedef void (*HDScenarioFunc) (HDCallgrindBench *bench);
+
+static gchar *
+get_plugin_id (guint i)
+{
+  return g_strdup_printf ("hd-bench-plugin-%u.desktop", i);
+}
+
+/* Same keys as status-menu.plugins, every plugin has a status area
+ * icon and a menu item */
+static GKeyFile *
+create_plugin_configuration (void)
+{
+  GKeyFile *keyfile = g_key_file_new ();
+  gint i;
+
+  for (i = 0; i < n_plugins; i++)
+    {
+      gchar *plugin_id = get_plugin_id (i);
+
+      g_key_file_set_integer (keyfile, plugin_id,
+                              HD_STATUS_AREA_CONFIG_KEY_POSITION, i);
+      g_key_file_set_integer (keyfile, plugin_id,
+                              HD_STATUS_MENU_CONFIG_KEY_POSITION, i);
+
+      g_free (plugin_id);
+    }
+
+  return keyfile;
+}
+
+/* Handles everything the operation queued, so its layout and drawing
+ * are counted with it */
+static void
+process_pending (void)
+{
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+  gdk_window_process_all_updates ();
+  hd_bench_flush ();
+}
+
+static void
+add_plugins (HDCallgrindBench *bench)
+{
+  gint i;
+
+  for (i = 0; i < n_plugins; i++)
+    {
+      gchar *plugin_id = get_plugin_id (i);
+      GtkWidget *plugin = hd_bench_plugin_new (plugin_id);
+
+      g_ptr_array_add (bench->plugins, g_object_ref_sink (plugin));
+      g_signal_emit_by_name (bench->plugin_manager, "plugin-added", plugin);
+      gtk_widget_show (plugin);
+      hd_bench_plugin_update_icon (HD_BENCH_PLUGIN (plugin));
+
+      g_free (plugin_id);
+    }
+
+  process_pending ();
+}
+
+static void
+scenario_plugin_load (HDCallgrindBench *bench)
+{
+  CALLGRIND_TOGGLE_COLLECT;
+  add_plugins (bench);
+  CALLGRIND_TOGGLE_COLLECT;
+}
+
+static void
+scenario_icon_burst (HDCallgrindBench *bench)
+{
+  gint i;
+  guint j;
+
+  add_plugins (bench);
+
+  CALLGRIND_TOGGLE_COLLECT;
+  for (i = 0; i < iterations; i++)
+    {
+      for (j = 0; j < bench->plugins->len; j++)
+        hd_bench_plugin_update_icon (g_ptr_array_index (bench->plugins, j));
+      process_pending ();
+    }
+  CALLGRIND_TOGGLE_COLLECT;
+}
+
+static void
+scenario_visibility_flip (HDCallgrindBench *bench)
+{
+  gint i;
+
+  add_plugins (bench);
+
+  CALLGRIND_TOGGLE_COLLECT;
+  for (i = 0; i < iterations; i++)
+    {
+      hd_bench_plugin_toggle_visible (g_ptr_array_index (bench->plugins,
+                                                         i % bench->plugins->len));
+      process_pending ();
+    }
+  CALLGRIND_TOGGLE_COLLECT;
+}
+
+/* The X server can not be rotated here, ::size-changed runs the same
+ * relayout of the status area, its box and the menu with the current
+ * screen size */
+static void
+scenario_rotation (HDCallgrindBench *bench)
+{
+  GdkScreen *screen = gdk_screen_get_default ();
+  gint i;
+
+  add_plugins (bench);
+
+  CALLGRIND_TOGGLE_COLLECT;
+  for (i = 0; i < iterations; i++)
+    {
+      g_signal_emit_by_name (screen, "size-changed");
+      process_pending ();
+    }
+  CALLGRIND_TOGGLE_COLLECT;
+}
+
+static void
+scenario_menu (HDCallgrindBench *bench)
+{
+  GtkWidget *status_menu = hd_bench_find_status_menu ();
+  gint i;
+
+  add_plugins (bench);
+
+  /* The first open packs the deferred items and realizes the menu,
+   * which plugin-load covers */
+  hd_bench_open_status_menu (bench->status_area);
+  gtk_widget_hide (status_menu);
+  process_pending ();
+
+  CALLGRIND_TOGGLE_COLLECT;
+  for (i = 0; i < iterations; i++)
+    {
+      hd_bench_open_status_menu (bench->status_area);
+      process_pending ();
+      gtk_widget_hide (status_menu);
+      process_pending ();
+    }
+  CALLGRIND_TOGGLE_COLLECT;
+}
+
+static const struct
+{
+  const gchar    *name;
+  HDScenarioFunc  func;
+} scenarios[] =
+{
+  { "plugin-load", scenario_plugin_load },
+  { "icon-burst", scenario_icon_burst },
+  { "visibility-flip", scenario_visibility_flip },
+  { "rotation", scenario_rotation },
+  { "menu", scenario_menu }
+};
+
+int
+main (int argc, char **argv)
+{
+  HDCallgrindBench bench = { 0, };
+  HDScenarioFunc func = NULL;
+  GOptionContext *context;
+  GError *error = NULL;
+  GKeyFile *keyfile;
+  guint i;
+
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
+  context = g_option_context_new ("- run a status area scenario under callgrind");
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_group (context, gtk_get_option_group (TRUE));
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (context);
+
+  for (i = 0; scenario && i < G_N_ELEMENTS (scenarios); i++)
+    if (!strcmp (scenario, scenarios[i].name))
+      func = scenarios[i].func;
+
+  if (!func)
+    {
+      g_printerr ("Unknown scenario %s\n", scenario ? scenario : "(none)");
+      return 1;
+    }
+
+  if (!RUNNING_ON_VALGRIND)
+    {
+      g_printerr ("Not running under callgrind, use run-callgrind.sh\n");
+      return 1;
+    }
+
+  n_plugins = MAX (n_plugins, 1);
+  iterations = MAX (iterations, 1);
+
+  hildon_init ();
+
+  bench.plugins = g_ptr_array_new ();
+  bench.plugin_manager = hd_plugin_manager_new (hd_config_file_new (g_get_tmp_dir (),
+                                                                    NULL,
+                                                                    "hd-callgrind-bench.conf"));
+
+  keyfile = create_plugin_configuration ();
+  hd_status_menu_config_load (keyfile);
+
+  bench.status_area = hd_status_area_new (bench.plugin_manager);
+  gtk_widget_show (bench.status_area);
+  process_pending ();
+
+  func (&bench);
+
+  for (i = 0; i < bench.plugins->len; i++)
+    {
+      GObject *plugin = g_ptr_array_index (bench.plugins, i);
+
+      g_signal_emit_by_name (bench.plugin_manager, "plugin-removed", plugin);
+      g_object_unref (plugin);
+    }
+  g_ptr_array_free (bench.plugins, TRUE);
+
+  gtk_widget_destroy (bench.status_area);
+  g_key_file_free (keyfile);
+
+  return 0;
+}
@@ -0,0 +1,337 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/* Microbenchmarks of the status area and status menu boxes, which are
+ * laid out again on every icon show or hide and every rotation. Each
+ * box operation is timed with N dummy children for several fractions
+ * of hidden children, and for several column counts of the menu box,
+ * and reported in ns per operation. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtk/gtk.h>
+
+#include "hd-bench.h"
+#include "hd-status-area-box.h"
+#include "hd-status-menu-box.h"
+
+/* Size of the dummy children, a status area icon and a menu item */
+#define AREA_CHILD_WIDTH   18
+#define AREA_CHILD_HEIGHT  36
+#define MENU_CHILD_WIDTH  400
+#define MENU_CHILD_HEIGHT  70
+
+#define MENU_WIDTH 800
+
+static gint n_children = 20;
+static gint n_builds = 200;
+static gint n_repeats = 50;
+static gint seed = 1;
+static gchar *output = NULL;
+
+static GOptionEntry entries[] =
+{
+  { "children", 'n', 0, G_OPTION_ARG_INT, &n_children, "Number of dummy children", "N" },
+  { "builds", 'b', 0, G_OPTION_ARG_INT, &n_builds, "Times each box is built and torn down", "N" },
+  { "repeats", 'r', 0, G_OPTION_ARG_INT, &n_repeats, "Layout passes and reorders per build", "N" },
+  { "seed", 's', 0, G_OPTION_ARG_INT, &seed, "Seed of the reorder positions", "SEED" },
+  { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "Write the JSON report to FILE", "FILE" },
+  { NULL }
+};
+
+static const gdouble hidden_fractions[] = { 0.0, 0.25, 0.5, 0.75 };
+static const guint menu_columns[] = { 1, 2, 3, 4 };
+
+enum
+{
+  OP_PACK,
+  OP_SIZE_REQUEST,
+  OP_SIZE_ALLOCATE,
+  OP_REORDER_CHILD,
+  OP_REMOVE,
+
+  N_OPS
+};
+
+static const gchar *op_names[N_OPS] =
+{
+  "pack",
+  "size_request",
+  "size_allocate",
+  "reorder_child",
+  "remove"
+};
+
+typedef struct _HDLayoutCase HDLayoutCase;
+struct _HDLayoutCase
+{
+  gboolean menu;     /* HDStatusMenuBox instead of HDStatusAreaBox */
+  guint    columns;  /* of the menu box */
+  gdouble  hidden;   /* fraction of hidden children */
+
+  gint64   ns[N_OPS];
+  guint64  count[N_OPS];
+};
+
+static GtkWidget *
+create_box (HDLayoutCase *layout_case)
+{
+  if (layout_case->menu)
+    return g_object_new (HD_TYPE_STATUS_MENU_BOX,
+                         "columns", layout_case->columns,
+                         NULL);
+
+  return hd_status_area_box_new ();
+}
+
+static void
+pack (HDLayoutCase *layout_case,
+      GtkWidget    *box,
+      GtkWidget    *child,
+      guint         position)
+{
+  if (layout_case->menu)
+    hd_status_menu_box_pack (HD_STATUS_MENU_BOX (box), child, position);
+  else
+    hd_status_area_box_pack (HD_STATUS_AREA_BOX (box), child, position);
+}
+
+static void
+reorder_child (HDLayoutCase *layout_case,
+               GtkWidget    *box,
+               GtkWidget    *child,
+               guint         position)
+{
+  if (layout_case->menu)
+    hd_status_menu_box_reorder_child (HD_STATUS_MENU_BOX (box), child, position);
+  else
+    hd_status_area_box_reorder_child (HD_STATUS_AREA_BOX (box), child, position);
+}
+
+/* Hidden children are spread evenly over the positions */
+static GPtrArray *
+create_children (HDLayoutCase *layout_case)
+{
+  GPtrArray *children = g_ptr_array_new ();
+  gint i;
+
+  for (i = 0; i < n_children; i++)
+    {
+      GtkWidget *child = gtk_event_box_new ();
+
+      if (layout_case->menu)
+        gtk_widget_set_size_request (child, MENU_CHILD_WIDTH, MENU_CHILD_HEIGHT);
+      else
+        gtk_widget_set_size_request (child, AREA_CHILD_WIDTH, AREA_CHILD_HEIGHT);
+
+      if ((gint) ((i + 1) * layout_case->hidden) == (gint) (i * layout_case->hidden))
+        gtk_widget_show (child);
+
+      g_ptr_array_add (children, g_object_ref_sink (child));
+    }
+
+  return children;
+}
+
+static void
+free_children (GPtrArray *children)
+{
+  guint i;
+
+  for (i = 0; i < children->len; i++)
+    gtk_widget_destroy (g_ptr_array_index (children, i));
+  for (i = 0; i < children->len; i++)
+    g_object_unref (g_ptr_array_index (children, i));
+
+  g_ptr_array_free (children, TRUE);
+}
+
+static void
+add_time (HDLayoutCase *layout_case,
+          guint         op,
+          gint64        start,
+          guint         count)
+{
+  layout_case->ns[op] += hd_bench_get_time_ns () - start;
+  layout_case->count[op] += count;
+}
+
+/* The size_request and size_allocate implementations are called
+ * directly: gtk_widget_size_request () skips boxes which have not
+ * queued a resize and would only measure the cached requisition. */
+static void
+run_case (HDLayoutCase *layout_case,
+          GRand        *rand)
+{
+  GPtrArray *children = create_children (layout_case);
+  gint build;
+
+  for (build = 0; build < n_builds; build++)
+    {
+      GtkWidget *box = g_object_ref_sink (create_box (layout_case));
+      GtkWidgetClass *widget_class = GTK_WIDGET_GET_CLASS (box);
+      GtkRequisition requisition = { 0, 0 };
+      GtkAllocation allocation = { 0, 0, 0, 0 };
+      gint64 start;
+      gint i;
+
+      start = hd_bench_get_time_ns ();
+      for (i = 0; i < n_children; i++)
+        pack (layout_case, box, g_ptr_array_index (children, i), i);
+      add_time (layout_case, OP_PACK, start, n_children);
+
+      start = hd_bench_get_time_ns ();
+      for (i = 0; i < n_repeats; i++)
+        widget_class->size_request (box, &requisition);
+      add_time (layout_case, OP_SIZE_REQUEST, start, n_repeats);
+
+      allocation.width = layout_case->menu ? MENU_WIDTH : requisition.width;
+      allocation.height = requisition.height;
+
+      start = hd_bench_get_time_ns ();
+      for (i = 0; i < n_repeats; i++)
+        widget_class->size_allocate (box, &allocation);
+      add_time (layout_case, OP_SIZE_ALLOCATE, start, n_repeats);
+
+      start = hd_bench_get_time_ns ();
+      for (i = 0; i < n_repeats; i++)
+        reorder_child (layout_case, box,
+                       g_ptr_array_index (children,
+                                          g_rand_int_range (rand, 0, n_children)),
+                       g_rand_int_range (rand, 0, n_children));
+      add_time (layout_case, OP_REORDER_CHILD, start, n_repeats);
+
+      start = hd_bench_get_time_ns ();
+      for (i = 0; i < n_children; i++)
+        gtk_container_remove (GTK_CONTAINER (box), g_ptr_array_index (children, i));
+      add_time (layout_case, OP_REMOVE, start, n_children);
+
+      gtk_widget_destroy (box);
+      g_object_unref (box);
+    }
+
+  free_children (children);
+}
+
+static void
+write_case_json (HDLayoutCase *layout_case,
+                 FILE         *file)
+{
+  guint op;
+
+  fprintf (file, "    { \"box\": \"%s\", \"columns\": %u, \"hidden\": %.2f",
+           layout_case->menu ? "status_menu_box" : "status_area_box",
+           layout_case->columns,
+           layout_case->hidden);
+
+  for (op = 0; op < N_OPS; op++)
+    fprintf (file, ", \"%s_ns\": %.1f",
+             op_names[op],
+             layout_case->count[op] ?
+               (gdouble) layout_case->ns[op] / layout_case->count[op] : 0.0);
+
+  fprintf (file, " }");
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  GArray *cases;
+  GRand *rand;
+  FILE *file = stdout;
+  guint i, j;
+
+  context = g_option_context_new ("- benchmark the status area and menu box layout");
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_group (context, gtk_get_option_group (TRUE));
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (context);
+
+  n_children = MAX (n_children, 1);
+  n_builds = MAX (n_builds, 1);
+  n_repeats = MAX (n_repeats, 1);
+
+  cases = g_array_new (FALSE, TRUE, sizeof (HDLayoutCase));
+  rand = g_rand_new_with_seed (seed);
+
+  /* The status area box has no columns, it lays out one row in
+   * landscape and two in portrait, depending on the screen */
+  for (i = 0; i < G_N_ELEMENTS (hidden_fractions); i++)
+    {
+      HDLayoutCase layout_case = { FALSE, 0, hidden_fractions[i], };
+
+      g_array_append_val (cases, layout_case);
+    }
+
+  for (j = 0; j < G_N_ELEMENTS (menu_columns); j++)
+    for (i = 0; i < G_N_ELEMENTS (hidden_fractions); i++)
+      {
+        HDLayoutCase layout_case = { TRUE, menu_columns[j], hidden_fractions[i], };
+
+        g_array_append_val (cases, layout_case);
+      }
+
+  for (i = 0; i < cases->len; i++)
+    run_case (&g_array_index (cases, HDLayoutCase, i), rand);
+
+  if (output)
+    {
+      file = fopen (output, "w");
+      if (!file)
+        {
+          g_printerr ("Could not open %s\n", output);
+          return 1;
+        }
+    }
+
+  fprintf (file, "{\n");
+  fprintf (file, "  \"benchmark\": \"layout\",\n");
+  fprintf (file, "  \"config\": { \"children\": %d, \"builds\": %d, \"repeats\": %d, "
+           "\"screen\": \"%dx%d\" },\n",
+           n_children, n_builds, n_repeats,
+           gdk_screen_get_width (gdk_screen_get_default ()),
+           gdk_screen_get_height (gdk_screen_get_default ()));
+  fprintf (file, "  \"cases\": [\n");
+  for (i = 0; i < cases->len; i++)
+    {
+      write_case_json (&g_array_index (cases, HDLayoutCase, i), file);
+      fprintf (file, i + 1 < cases->len ? ",\n" : "\n");
+    }
+  fprintf (file, "  ]\n");
+  fprintf (file, "}\n");
+
+  if (file != stdout)
+    fclose (file);
+
+  g_rand_free (rand);
+  g_array_free (cases, TRUE);
+
+  return 0;
+}
@@ -0,0 +1,356 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/* Loads the plugins written by gen-plugins.sh with the real plugin
+ * manager and measures how loading, box layout and opening the menu
+ * scale with the number of plugins. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <libhildondesktop/libhildondesktop.h>
+#include <hildon/hildon.h>
+
+#include <stdlib.h>
+
+#include "hd-bench.h"
+#include "hd-plugin-stats.h"
+#include "hd-status-area.h"
+#include "hd-status-area-box.h"
+#include "hd-status-menu-box.h"
+#include "hd-status-menu-config.h"
+
+/* Give up waiting for plugins after this many seconds */
+#define LOAD_TIMEOUT 120
+
+static gchar *conf_dir = NULL;
+static gint menu_cycles = 5;
+static gchar *output = NULL;
+
+static GOptionEntry entries[] =
+{
+  { "conf-dir", 'c', 0, G_OPTION_ARG_FILENAME, &conf_dir, "Directory with the generated status-menu.conf", "DIR" },
+  { "menu-cycles", 'm', 0, G_OPTION_ARG_INT, &menu_cycles, "Menu open and close cycles", "N" },
+  { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "Write the JSON report to FILE", "FILE" },
+  { NULL }
+};
+
+enum
+{
+  SERIES_PLUGIN_ADDED,
+  SERIES_AREA_BOX_LAYOUT,
+  SERIES_MENU_BOX_LAYOUT,
+  SERIES_MENU_OPEN,
+
+  N_SERIES
+};
+
+static const gchar *series_names[N_SERIES] =
+{
+  "plugin_added",
+  "area_box_layout",
+  "menu_box_layout",
+  "menu_open"
+};
+
+typedef struct _HDScalingBench HDScalingBench;
+struct _HDScalingBench
+{
+  HDPluginManager *plugin_manager;
+  GtkWidget       *status_area;
+  GtkWidget       *area_box;
+  GtkWidget       *menu_box;
+
+  HDBenchSeries   *series[N_SERIES];
+
+  guint            n_plugins;
+  guint            expected;
+  gint64           plugin_added_start;
+
+  /* waits for plugins loaded from idle callbacks */
+  GMainLoop       *loop;
+  guint            load_timeout_id;
+};
+
+static guint
+load_priority_func (const gchar *plugin_id,
+                    GKeyFile    *keyfile,
+                    gpointer     data)
+{
+  const HDStatusMenuConfigRecord *record;
+
+  /* Same order as hildon-status-menu */
+  record = hd_status_menu_config_lookup (plugin_id);
+
+  if (record->permanent)
+    return 0;
+  if (hd_status_menu_config_is_menu_only (record))
+    return G_MAXUINT - 1;
+
+  return record->area_position;
+}
+
+static void
+items_configuration_loaded_cb (HDPluginManager *plugin_manager,
+                               GKeyFile        *keyfile,
+                               gpointer         data)
+{
+  hd_status_menu_config_load (keyfile);
+}
+
+/* Connected before the status area and menu */
+static void
+plugin_added_first_cb (HDPluginManager *plugin_manager,
+                       GObject         *plugin,
+                       HDScalingBench  *bench)
+{
+  hd_plugin_stats_register (plugin);
+
+  bench->plugin_added_start = hd_bench_get_time_us ();
+}
+
+/* Time of a size request and allocation of @box */
+static void
+measure_layout (GtkWidget     *box,
+                HDBenchSeries *series)
+{
+  GtkRequisition requisition;
+  GtkAllocation allocation;
+  gint64 start;
+
+  if (!box)
+    return;
+
+  start = hd_bench_get_time_us ();
+
+  gtk_widget_size_request (box, &requisition);
+  allocation = box->allocation;
+  allocation.width = MAX (allocation.width, requisition.width);
+  allocation.height = MAX (allocation.height, requisition.height);
+  gtk_widget_size_allocate (box, &allocation);
+
+  hd_bench_series_add (series,
+                       (hd_bench_get_time_us () - start) / 1000.0,
+                       0);
+}
+
+/* Connected after the status area and menu */
+static void
+plugin_added_last_cb (HDPluginManager *plugin_manager,
+                      GObject         *plugin,
+                      HDScalingBench  *bench)
+{
+  hd_bench_series_add (bench->series[SERIES_PLUGIN_ADDED],
+                       (hd_bench_get_time_us () - bench->plugin_added_start) / 1000.0,
+                       0);
+
+  measure_layout (bench->area_box, bench->series[SERIES_AREA_BOX_LAYOUT]);
+  measure_layout (bench->menu_box, bench->series[SERIES_MENU_BOX_LAYOUT]);
+
+  bench->n_plugins++;
+
+  if (bench->n_plugins >= bench->expected &&
+      g_main_loop_is_running (bench->loop))
+    g_main_loop_quit (bench->loop);
+}
+
+static gboolean
+load_timeout_cb (HDScalingBench *bench)
+{
+  bench->load_timeout_id = 0;
+  g_main_loop_quit (bench->loop);
+
+  return FALSE;
+}
+
+static guint
+count_plugins (const gchar *dir)
+{
+  GDir *plugins;
+  guint n = 0;
+
+  plugins = g_dir_open (dir, 0, NULL);
+  if (!plugins)
+    return 0;
+
+  while (g_dir_read_name (plugins))
+    n++;
+  g_dir_close (plugins);
+
+  return n;
+}
+
+static void
+write_report (HDScalingBench *bench,
+              FILE           *file,
+              guint           expected,
+              gdouble         run_ms,
+              gdouble         user_ms,
+              gdouble         system_ms)
+{
+  guint i;
+
+  fprintf (file, "{\n");
+  fprintf (file, "  \"benchmark\": \"scaling\",\n");
+  fprintf (file, "  \"config\": { \"plugins\": %u, \"menu_cycles\": %d },\n",
+           expected, menu_cycles);
+  fprintf (file, "  \"loaded_plugins\": %u,\n", bench->n_plugins);
+  fprintf (file, "  \"manager_run_ms\": %.3f,\n", run_ms);
+  fprintf (file, "  \"manager_run_ms_per_plugin\": %.4f,\n",
+           bench->n_plugins ? run_ms / bench->n_plugins : 0.0);
+  fprintf (file, "  \"cpu\": { \"user_ms\": %.1f, \"system_ms\": %.1f },\n",
+           user_ms, system_ms);
+  fprintf (file, "  \"series\": {\n");
+  for (i = 0; i < N_SERIES; i++)
+    {
+      hd_bench_series_write_json (bench->series[i], file);
+      fprintf (file, i + 1 < N_SERIES ? ",\n" : "\n");
+    }
+  fprintf (file, "  }\n");
+  fprintf (file, "}\n");
+}
+
+int
+main (int argc, char **argv)
+{
+  HDScalingBench bench = { 0, };
+  GOptionContext *context;
+  GError *error = NULL;
+  gchar *plugin_dir;
+  guint expected, i;
+  gint64 start;
+  gdouble run_ms, user_start, system_start, user_end, system_end;
+  FILE *file = stdout;
+
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
+  context = g_option_context_new ("- benchmark loading generated plugins");
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_group (context, gtk_get_option_group (TRUE));
+  if (!g_option_context_parse (context, &argc, &argv, &error) || !conf_dir)
+    {
+      g_printerr ("%s\n", error ? error->message : "--conf-dir is required");
+      return 1;
+    }
+  g_option_context_free (context);
+
+  hildon_init ();
+
+  for (i = 0; i < N_SERIES; i++)
+    bench.series[i] = hd_bench_series_new (series_names[i]);
+
+  plugin_dir = g_build_filename (conf_dir, "plugins", NULL);
+  expected = count_plugins (plugin_dir);
+  g_free (plugin_dir);
+
+  bench.expected = expected;
+  bench.loop = g_main_loop_new (NULL, FALSE);
+
+  bench.plugin_manager = hd_plugin_manager_new (hd_config_file_new (conf_dir,
+                                                                    NULL,
+                                                                    "status-menu.conf"));
+
+  /* As in hildon-status-menu, the configuration is parsed before the
+   * status area and menu handle it */
+  g_signal_connect (bench.plugin_manager, "items-configuration-loaded",
+                    G_CALLBACK (items_configuration_loaded_cb), NULL);
+  g_signal_connect (bench.plugin_manager, "plugin-added",
+                    G_CALLBACK (plugin_added_first_cb), &bench);
+  hd_plugin_manager_set_load_priority_func (bench.plugin_manager,
+                                            load_priority_func,
+                                            NULL,
+                                            NULL);
+
+  bench.status_area = hd_status_area_new (bench.plugin_manager);
+  gtk_widget_show (bench.status_area);
+
+  bench.area_box = hd_bench_find_widget (bench.status_area, HD_TYPE_STATUS_AREA_BOX);
+  if (hd_bench_find_status_menu ())
+    bench.menu_box = hd_bench_find_widget (hd_bench_find_status_menu (),
+                                           HD_TYPE_STATUS_MENU_BOX);
+
+  g_signal_connect_after (bench.plugin_manager, "plugin-added",
+                          G_CALLBACK (plugin_added_last_cb), &bench);
+  hd_bench_flush ();
+
+  hd_bench_get_cpu_time (&user_start, &system_start);
+
+  /* Plugins may be loaded from idle callbacks, wait for all of them.
+   * The loop blocks until the last one is added or the timeout */
+  start = hd_bench_get_time_us ();
+  hd_plugin_manager_run (bench.plugin_manager);
+  if (bench.n_plugins < expected)
+    {
+      bench.load_timeout_id = g_timeout_add_seconds (LOAD_TIMEOUT,
+                                                     (GSourceFunc) load_timeout_cb,
+                                                     &bench);
+
+      g_main_loop_run (bench.loop);
+
+      if (bench.load_timeout_id)
+        g_source_remove (bench.load_timeout_id);
+    }
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+  hd_bench_flush ();
+  run_ms = (hd_bench_get_time_us () - start) / 1000.0;
+
+  if (bench.n_plugins < expected)
+    g_printerr ("Only %u of %u plugins were loaded\n", bench.n_plugins, expected);
+
+  for (i = 0; i < (guint) menu_cycles; i++)
+    {
+      GtkWidget *status_menu;
+
+      hd_bench_series_begin (bench.series[SERIES_MENU_OPEN]);
+      hd_bench_open_status_menu (bench.status_area);
+      hd_bench_series_end (bench.series[SERIES_MENU_OPEN]);
+
+      status_menu = hd_bench_find_status_menu ();
+      if (status_menu)
+        gtk_widget_hide (status_menu);
+      hd_bench_flush ();
+    }
+
+  hd_bench_get_cpu_time (&user_end, &system_end);
+
+  if (output)
+    {
+      file = fopen (output, "w");
+      if (!file)
+        {
+          g_printerr ("Could not open %s\n", output);
+          return 1;
+        }
+    }
+
+  write_report (&bench, file, expected, run_ms,
+                user_end - user_start,
+                system_end - system_start);
+
+  if (file != stdout)
+    fclose (file);
+
+  return 0;
+}
@@ -0,0 +1,533 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/* Runs the real status area and menu against synthetic plugins and
+ * writes latency percentiles, CPU time and X request counts as JSON.
+ * Use run-bench.sh to get a private X server and D-Bus buses. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <libhildondesktop/libhildondesktop.h>
+#include <hildon/hildon.h>
+
+#include <stdlib.h>
+
+#include "hd-bench.h"
+#include "hd-bench-plugin.h"
+#include "hd-metrics.h"
+#include "hd-plugin-stats.h"
+#include "hd-status-area.h"
+#include "hd-status-menu.h"
+#include "hd-status-menu-config.h"
+
+static gint n_plugins = 20;
+static gdouble icon_rate = 1.0;
+static gdouble visibility_rate = 0.5;
+static gint menu_cycles = 10;
+static gint duration = 10;
+static gint seed = 1;
+static gchar *output = NULL;
+static gchar *metrics = NULL;
+
+/* Round trips of the instrumented X paths per operation, on average */
+static gdouble menu_open_budget = 3.0;
+static gdouble area_visibility_budget = 2.0;
+static gboolean check_budgets = FALSE;
+
+/* Icon redraws per second allowed by the configuration, 0 if unlimited */
+static gint icon_rate_limit = 0;
+
+static GOptionEntry entries[] =
+{
+  { "plugins", 'n', 0, G_OPTION_ARG_INT, &n_plugins, "Number of synthetic plugins", "N" },
+  { "icon-rate", 'i', 0, G_OPTION_ARG_DOUBLE, &icon_rate, "Icon updates per second of each plugin", "HZ" },
+  { "visibility-rate", 'v', 0, G_OPTION_ARG_DOUBLE, &visibility_rate, "Menu item visibility flips per second", "HZ" },
+  { "menu-cycles", 'm', 0, G_OPTION_ARG_INT, &menu_cycles, "Menu open and close cycles", "N" },
+  { "duration", 'd', 0, G_OPTION_ARG_INT, &duration, "Duration of the update phase in seconds", "S" },
+  { "seed", 's', 0, G_OPTION_ARG_INT, &seed, "Seed of the visibility flips", "SEED" },
+  { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "Write the JSON report to FILE", "FILE" },
+  { "metrics", 0, 0, G_OPTION_ARG_FILENAME, &metrics, "Write the metrics checked by make check-perf to FILE", "FILE" },
+  { "menu-open-budget", 0, 0, G_OPTION_ARG_DOUBLE, &menu_open_budget, "Round trips allowed per menu open", "N" },
+  { "area-visibility-budget", 0, 0, G_OPTION_ARG_DOUBLE, &area_visibility_budget, "Round trips allowed per status area visibility change", "N" },
+  { "check-budgets", 0, 0, G_OPTION_ARG_NONE, &check_budgets, "Fail when a round trip budget is exceeded", NULL },
+  { "icon-rate-limit", 0, 0, G_OPTION_ARG_INT, &icon_rate_limit, "Configure a redraw limit for each plugin and fail when it is exceeded or the last icon is not shown", "HZ" },
+  { NULL }
+};
+
+enum
+{
+  SERIES_PLUGIN_ADDED,
+  SERIES_ICON_UPDATE,
+  SERIES_VISIBILITY_FLIP,
+  SERIES_MENU_OPEN,
+  SERIES_MENU_CLOSE,
+  SERIES_AREA_VISIBILITY,
+  SERIES_PLUGIN_REMOVED,
+
+  N_SERIES
+};
+
+static const gchar *series_names[N_SERIES] =
+{
+  "plugin_added",
+  "icon_update",
+  "visibility_flip",
+  "menu_open",
+  "menu_close",
+  "area_visibility",
+  "plugin_removed"
+};
+
+typedef struct _HDStatusBench HDStatusBench;
+struct _HDStatusBench
+{
+  HDPluginManager *plugin_manager;
+  GtkWidget       *status_area;
+  GPtrArray       *plugins;
+
+  HDBenchSeries   *series[N_SERIES];
+
+  GRand           *rand;
+  GMainLoop       *loop;
+  gint             menu_cycles_left;
+  guint            icon_update_id;
+
+  /* icon redraws applied by the status area during the update phase */
+  guint            icon_applies;
+
+  /* creating the status area and adding the plugins */
+  gdouble          startup_ms;
+  guint            startup_allocations;
+};
+
+static gchar *
+get_plugin_id (guint i)
+{
+  return g_strdup_printf ("hd-bench-plugin-%u.desktop", i);
+}
+
+/* Same keys as status-menu.plugins, every plugin has a status area
+ * icon and a menu item */
+static GKeyFile *
+create_plugin_configuration (void)
+{
+  GKeyFile *keyfile = g_key_file_new ();
+  gint i;
+
+  for (i = 0; i < n_plugins; i++)
+    {
+      gchar *plugin_id = get_plugin_id (i);
+
+      g_key_file_set_integer (keyfile, plugin_id,
+                              HD_STATUS_AREA_CONFIG_KEY_POSITION, i);
+      g_key_file_set_integer (keyfile, plugin_id,
+                              HD_STATUS_MENU_CONFIG_KEY_POSITION, i);
+      if (icon_rate_limit > 0)
+        g_key_file_set_integer (keyfile, plugin_id,
+                                HD_STATUS_AREA_CONFIG_KEY_ICON_RATE,
+                                icon_rate_limit);
+
+      g_free (plugin_id);
+    }
+
+  return keyfile;
+}
+
+static void
+add_plugins (HDStatusBench *bench)
+{
+  gint i;
+
+  for (i = 0; i < n_plugins; i++)
+    {
+      gchar *plugin_id = get_plugin_id (i);
+      GtkWidget *plugin = hd_bench_plugin_new (plugin_id);
+
+      g_ptr_array_add (bench->plugins, g_object_ref_sink (plugin));
+
+      hd_bench_series_begin (bench->series[SERIES_PLUGIN_ADDED]);
+      hd_plugin_stats_register (G_OBJECT (plugin));
+      g_signal_emit_by_name (bench->plugin_manager, "plugin-added", plugin);
+      gtk_widget_show (plugin);
+      hd_bench_plugin_update_icon (HD_BENCH_PLUGIN (plugin));
+      hd_bench_series_end (bench->series[SERIES_PLUGIN_ADDED]);
+
+      g_free (plugin_id);
+    }
+}
+
+static void
+remove_plugins (HDStatusBench *bench)
+{
+  guint i;
+
+  for (i = 0; i < bench->plugins->len; i++)
+    {
+      GObject *plugin = g_ptr_array_index (bench->plugins, i);
+
+      hd_bench_series_begin (bench->series[SERIES_PLUGIN_REMOVED]);
+      g_signal_emit_by_name (bench->plugin_manager, "plugin-removed", plugin);
+      hd_plugin_stats_unregister (plugin);
+      hd_bench_series_end (bench->series[SERIES_PLUGIN_REMOVED]);
+
+      g_object_unref (plugin);
+    }
+
+  g_ptr_array_set_size (bench->plugins, 0);
+}
+
+static gboolean
+icon_update_cb (HDStatusBench *bench)
+{
+  guint i;
+
+  for (i = 0; i < bench->plugins->len; i++)
+    {
+      hd_bench_series_begin (bench->series[SERIES_ICON_UPDATE]);
+      hd_bench_plugin_update_icon (g_ptr_array_index (bench->plugins, i));
+      hd_bench_series_end (bench->series[SERIES_ICON_UPDATE]);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+visibility_flip_cb (HDStatusBench *bench)
+{
+  HDBenchPlugin *plugin;
+
+  plugin = g_ptr_array_index (bench->plugins,
+                              g_rand_int_range (bench->rand, 0, bench->plugins->len));
+
+  hd_bench_series_begin (bench->series[SERIES_VISIBILITY_FLIP]);
+  hd_bench_plugin_toggle_visible (plugin);
+  hd_bench_series_end (bench->series[SERIES_VISIBILITY_FLIP]);
+
+  return TRUE;
+}
+
+static gboolean
+menu_cycle_cb (HDStatusBench *bench)
+{
+  GtkWidget *status_menu;
+
+  hd_bench_series_begin (bench->series[SERIES_MENU_OPEN]);
+  hd_bench_open_status_menu (bench->status_area);
+  hd_bench_series_end (bench->series[SERIES_MENU_OPEN]);
+
+  status_menu = hd_bench_find_status_menu ();
+  if (status_menu)
+    {
+      hd_bench_series_begin (bench->series[SERIES_MENU_CLOSE]);
+      gtk_widget_hide (status_menu);
+      hd_bench_series_end (bench->series[SERIES_MENU_CLOSE]);
+    }
+
+  /* The status area checks whether it is on screen on configure
+   * events, the compositor moves it away to hide it. The sync makes
+   * sure the configure notify is handled within the operation. */
+  hd_bench_series_begin (bench->series[SERIES_AREA_VISIBILITY]);
+  gtk_window_move (GTK_WINDOW (bench->status_area), -1000, 0);
+  hd_bench_flush ();
+  hd_bench_series_end (bench->series[SERIES_AREA_VISIBILITY]);
+
+  hd_bench_series_begin (bench->series[SERIES_AREA_VISIBILITY]);
+  gtk_window_move (GTK_WINDOW (bench->status_area), 0, 0);
+  hd_bench_flush ();
+  hd_bench_series_end (bench->series[SERIES_AREA_VISIBILITY]);
+
+  return --bench->menu_cycles_left > 0;
+}
+
+static gboolean
+quit_cb (HDStatusBench *bench)
+{
+  g_main_loop_quit (bench->loop);
+
+  return FALSE;
+}
+
+static void
+write_report (HDStatusBench *bench,
+              FILE          *file,
+              gdouble        user_ms,
+              gdouble        system_ms,
+              gulong         x_requests)
+{
+  guint i;
+
+  fprintf (file, "{\n");
+  fprintf (file, "  \"benchmark\": \"status-area\",\n");
+  fprintf (file, "  \"config\": { \"plugins\": %d, \"icon_rate\": %.2f, "
+           "\"visibility_rate\": %.2f, \"menu_cycles\": %d, \"duration\": %d, "
+           "\"seed\": %d },\n",
+           n_plugins, icon_rate, visibility_rate, menu_cycles, duration, seed);
+  fprintf (file, "  \"cpu\": { \"user_ms\": %.1f, \"system_ms\": %.1f },\n",
+           user_ms, system_ms);
+  fprintf (file, "  \"startup\": { \"ms\": %.1f, \"allocations\": %u },\n",
+           bench->startup_ms, bench->startup_allocations);
+  fprintf (file, "  \"x_requests\": %lu,\n", x_requests);
+  fprintf (file, "  \"series\": {\n");
+  for (i = 0; i < N_SERIES; i++)
+    {
+      hd_bench_series_write_json (bench->series[i], file);
+      fprintf (file, i + 1 < N_SERIES ? ",\n" : "\n");
+    }
+  fprintf (file, "  },\n");
+  hd_bench_write_x_paths_json (file);
+  fprintf (file, "\n}\n");
+}
+
+/* One metric per line, compared with bench/baseline.json by
+ * compare-perf.sh. Lower is better for all of them, the _ms ones are
+ * checked with the time tolerance. */
+static gboolean
+write_metrics (HDStatusBench *bench,
+               const gchar   *filename)
+{
+  FILE *file = fopen (filename, "w");
+
+  if (!file)
+    {
+      g_printerr ("Could not open %s\n", filename);
+      return FALSE;
+    }
+
+  fprintf (file, "{\n");
+  fprintf (file, "  \"startup_ms\": %.1f,\n", bench->startup_ms);
+  fprintf (file, "  \"startup_allocations\": %u,\n", bench->startup_allocations);
+  fprintf (file, "  \"menu_open_p50_ms\": %.3f,\n",
+           hd_bench_series_percentile (bench->series[SERIES_MENU_OPEN], 50));
+  fprintf (file, "  \"menu_open_p90_ms\": %.3f,\n",
+           hd_bench_series_percentile (bench->series[SERIES_MENU_OPEN], 90));
+  fprintf (file, "  \"menu_open_round_trips\": %.2f,\n",
+           hd_bench_series_round_trips_per_op (bench->series[SERIES_MENU_OPEN]));
+  fprintf (file, "  \"menu_open_allocations\": %.1f,\n",
+           hd_bench_series_allocations_per_op (bench->series[SERIES_MENU_OPEN]));
+  fprintf (file, "  \"area_visibility_round_trips\": %.2f,\n",
+           hd_bench_series_round_trips_per_op (bench->series[SERIES_AREA_VISIBILITY]));
+  fprintf (file, "  \"icon_update_layout_passes\": %.2f,\n",
+           hd_bench_series_layout_passes_per_op (bench->series[SERIES_ICON_UPDATE]));
+  fprintf (file, "  \"icon_update_allocations\": %.1f,\n",
+           hd_bench_series_allocations_per_op (bench->series[SERIES_ICON_UPDATE]));
+  fprintf (file, "  \"visibility_flip_layout_passes\": %.2f,\n",
+           hd_bench_series_layout_passes_per_op (bench->series[SERIES_VISIBILITY_FLIP]));
+  fprintf (file, "  \"visibility_flip_allocations\": %.1f\n",
+           hd_bench_series_allocations_per_op (bench->series[SERIES_VISIBILITY_FLIP]));
+  fprintf (file, "}\n");
+
+  fclose (file);
+
+  return TRUE;
+}
+
+/* Every plugin gets at most one redraw per interval, plus the one
+ * that shows the last icon of a burst after the update phase */
+static gboolean
+within_icon_rate_limit (HDStatusBench *bench)
+{
+  HDMetricsHistogram *icon_apply = hd_metrics_get_histogram ("icon-apply");
+  guint interval, allowed, i;
+  gboolean ok = TRUE;
+
+  /* Same rounding as the status area */
+  interval = 1000 / MIN (icon_rate_limit, 1000);
+
+  /* Wait for the icons still held back by the limit */
+  g_source_remove (bench->icon_update_id);
+  g_timeout_add (2 * interval, (GSourceFunc) quit_cb, bench);
+  g_main_loop_run (bench->loop);
+  hd_bench_flush ();
+
+  bench->icon_applies = icon_apply->count - bench->icon_applies;
+  allowed = bench->plugins->len * (duration * 1000 / interval + 1);
+
+  if (bench->icon_applies > allowed)
+    {
+      g_printerr ("icon_update: %u redraws applied, limit is %u\n",
+                  bench->icon_applies, allowed);
+      ok = FALSE;
+    }
+
+  for (i = 0; i < bench->plugins->len; i++)
+    {
+      GObject *plugin = g_ptr_array_index (bench->plugins, i);
+      GtkWidget *image = g_object_get_data (plugin, "hd_status_area_image");
+      GdkPixbuf *pixbuf;
+
+      g_object_get (plugin, "status-area-icon", &pixbuf, NULL);
+
+      if (!image || gtk_image_get_pixbuf (GTK_IMAGE (image)) != pixbuf)
+        {
+          g_printerr ("icon_update: %s does not show its last icon\n",
+                      hd_plugin_item_get_plugin_id (HD_PLUGIN_ITEM (plugin)));
+          ok = FALSE;
+        }
+
+      if (pixbuf)
+        g_object_unref (pixbuf);
+    }
+
+  return ok;
+}
+
+static gboolean
+within_budget (HDBenchSeries *series,
+               gdouble        budget)
+{
+  gdouble round_trips = hd_bench_series_round_trips_per_op (series);
+
+  if (round_trips <= budget)
+    return TRUE;
+
+  g_printerr ("%s: %.2f round trips per operation, budget is %.2f\n",
+              series->name, round_trips, budget);
+
+  return FALSE;
+}
+
+int
+main (int argc, char **argv)
+{
+  HDStatusBench bench = { 0, };
+  GOptionContext *context;
+  GError *error = NULL;
+  GKeyFile *keyfile;
+  gdouble user_start, system_start, user_end, system_end;
+  gulong requests_start;
+  FILE *file = stdout;
+  gint64 startup_start;
+  guint i;
+
+  hd_bench_count_allocations ();
+
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
+  context = g_option_context_new ("- benchmark the status area and menu");
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_group (context, gtk_get_option_group (TRUE));
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (context);
+
+  if (n_plugins < 1)
+    n_plugins = 1;
+
+  hildon_init ();
+  hd_bench_count_layout_passes ();
+
+  for (i = 0; i < N_SERIES; i++)
+    bench.series[i] = hd_bench_series_new (series_names[i]);
+  bench.plugins = g_ptr_array_new ();
+  bench.rand = g_rand_new_with_seed (seed);
+  bench.loop = g_main_loop_new (NULL, FALSE);
+  bench.menu_cycles_left = menu_cycles;
+
+  /* A plugin manager without plugins, the synthetic plugins are added
+   * by emitting its signals */
+  bench.plugin_manager = hd_plugin_manager_new (hd_config_file_new (g_get_tmp_dir (),
+                                                                    NULL,
+                                                                    "hd-status-bench.conf"));
+
+  keyfile = create_plugin_configuration ();
+  hd_status_menu_config_load (keyfile);
+
+  hd_bench_get_cpu_time (&user_start, &system_start);
+  requests_start = hd_bench_get_x_requests ();
+
+  startup_start = hd_bench_get_time_us ();
+  bench.startup_allocations = hd_bench_get_allocations ();
+
+  bench.status_area = hd_status_area_new (bench.plugin_manager);
+  gtk_widget_show (bench.status_area);
+  add_plugins (&bench);
+  hd_bench_flush ();
+
+  bench.startup_ms = (hd_bench_get_time_us () - startup_start) / 1000.0;
+  bench.startup_allocations = hd_bench_get_allocations () - bench.startup_allocations;
+
+  bench.icon_applies = hd_metrics_get_histogram ("icon-apply")->count;
+
+  if (icon_rate > 0)
+    bench.icon_update_id = g_timeout_add ((guint) (1000 / icon_rate),
+                                          (GSourceFunc) icon_update_cb, &bench);
+  if (visibility_rate > 0)
+    g_timeout_add ((guint) (1000 / visibility_rate),
+                   (GSourceFunc) visibility_flip_cb, &bench);
+  if (menu_cycles > 0)
+    g_timeout_add (duration * 1000 / menu_cycles,
+                   (GSourceFunc) menu_cycle_cb, &bench);
+  g_timeout_add_seconds (duration, (GSourceFunc) quit_cb, &bench);
+
+  g_main_loop_run (bench.loop);
+
+  if (icon_rate_limit > 0 && icon_rate > 0 &&
+      !within_icon_rate_limit (&bench))
+    return 2;
+
+  remove_plugins (&bench);
+
+  hd_bench_get_cpu_time (&user_end, &system_end);
+
+  if (output)
+    {
+      file = fopen (output, "w");
+      if (!file)
+        {
+          g_printerr ("Could not open %s\n", output);
+          return 1;
+        }
+    }
+
+  write_report (&bench, file,
+                user_end - user_start,
+                system_end - system_start,
+                hd_bench_get_x_requests () - requests_start);
+
+  if (file != stdout)
+    fclose (file);
+
+  if (metrics && !write_metrics (&bench, metrics))
+    return 1;
+
+  gtk_widget_destroy (bench.status_area);
+  g_key_file_free (keyfile);
+
+  if (check_budgets)
+    {
+      gboolean ok = TRUE;
+
+      ok &= within_budget (bench.series[SERIES_MENU_OPEN], menu_open_budget);
+      ok &= within_budget (bench.series[SERIES_AREA_VISIBILITY], area_visibility_budget);
+
+      if (!ok)
+        return 2;
+    }
+
+  return 0;
+}
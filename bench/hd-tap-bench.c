@@ -0,0 +1,397 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/* Taps the status area with XTest and measures how long the status
+ * menu takes to become visible: from sending the button release to
+ * the MapNotify of the menu window and to the end of its first expose.
+ * Use run-bench.sh to get a private X server, the screen size of the
+ * server decides between landscape and portrait layout. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <libhildondesktop/libhildondesktop.h>
+#include <hildon/hildon.h>
+
+#include <gdk/gdkx.h>
+#include <X11/extensions/XTest.h>
+
+#include "hd-bench.h"
+#include "hd-bench-plugin.h"
+#include "hd-status-area.h"
+#include "hd-status-menu.h"
+#include "hd-status-menu-config.h"
+
+/* A tap which does not show the menu within this time is a failure */
+#define TAP_TIMEOUT 2000
+
+/* Time for the menu to settle after closing, in ms */
+#define CLOSE_SETTLE_DELAY 100
+
+static gint n_items = 20;
+static gint n_taps = 30;
+static gchar *output = NULL;
+
+static GOptionEntry entries[] =
+{
+  { "items", 'n', 0, G_OPTION_ARG_INT, &n_items, "Number of menu items", "N" },
+  { "taps", 't', 0, G_OPTION_ARG_INT, &n_taps, "Number of measured taps", "N" },
+  { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output, "Write the JSON report to FILE", "FILE" },
+  { NULL }
+};
+
+enum
+{
+  SERIES_COLD_MAP,
+  SERIES_COLD_EXPOSE,
+  SERIES_MAP,
+  SERIES_EXPOSE,
+
+  N_SERIES
+};
+
+/* The first tap also pays for packing the deferred menu items */
+static const gchar *series_names[N_SERIES] =
+{
+  "cold_tap_to_map",
+  "cold_tap_to_expose",
+  "tap_to_map",
+  "tap_to_expose"
+};
+
+typedef struct _HDTapBench HDTapBench;
+struct _HDTapBench
+{
+  HDPluginManager *plugin_manager;
+  GtkWidget       *status_area;
+  GtkWidget       *status_menu;
+  GPtrArray       *plugins;
+
+  HDBenchSeries   *series[N_SERIES];
+
+  GMainLoop       *loop;
+  gint             taps_left;
+  guint            failures;
+  gboolean         cold;
+
+  /* state of the current tap */
+  gint64           release_time;
+  gboolean         mapped;
+  gboolean         exposed;
+  guint            timeout_id;
+  guint            expose_done_id;
+};
+
+static gboolean tap_cb (HDTapBench *bench);
+
+static gchar *
+get_plugin_id (guint i)
+{
+  return g_strdup_printf ("hd-bench-plugin-%u.desktop", i);
+}
+
+/* Menu items only, like most of the real status menu plugins */
+static GKeyFile *
+create_plugin_configuration (void)
+{
+  GKeyFile *keyfile = g_key_file_new ();
+  gint i;
+
+  for (i = 0; i < n_items; i++)
+    {
+      gchar *plugin_id = get_plugin_id (i);
+
+      g_key_file_set_integer (keyfile, plugin_id,
+                              HD_STATUS_MENU_CONFIG_KEY_POSITION, i);
+
+      g_free (plugin_id);
+    }
+
+  return keyfile;
+}
+
+static void
+add_plugins (HDTapBench *bench)
+{
+  gint i;
+
+  for (i = 0; i < n_items; i++)
+    {
+      gchar *plugin_id = get_plugin_id (i);
+      GtkWidget *plugin = hd_bench_plugin_new (plugin_id);
+
+      g_ptr_array_add (bench->plugins, g_object_ref_sink (plugin));
+      g_signal_emit_by_name (bench->plugin_manager, "plugin-added", plugin);
+      gtk_widget_show (plugin);
+
+      g_free (plugin_id);
+    }
+}
+
+static gdouble
+get_elapsed_ms (HDTapBench *bench)
+{
+  return (hd_bench_get_time_us () - bench->release_time) / 1000.0;
+}
+
+/* Ends the current tap once, whichever of the timeout and the expose
+ * comes first. Events of the tap arriving later are ignored. */
+static void
+finish_tap (HDTapBench *bench)
+{
+  if (bench->timeout_id)
+    {
+      g_source_remove (bench->timeout_id);
+      bench->timeout_id = 0;
+    }
+
+  if (bench->expose_done_id)
+    {
+      g_source_remove (bench->expose_done_id);
+      bench->expose_done_id = 0;
+    }
+
+  bench->release_time = 0;
+  bench->mapped = FALSE;
+  bench->exposed = FALSE;
+
+  gtk_widget_hide (bench->status_menu);
+  hd_bench_flush ();
+
+  bench->cold = FALSE;
+
+  if (--bench->taps_left >= 0)
+    g_timeout_add (CLOSE_SETTLE_DELAY, (GSourceFunc) tap_cb, bench);
+  else
+    g_main_loop_quit (bench->loop);
+}
+
+static gboolean
+tap_timeout_cb (HDTapBench *bench)
+{
+  bench->timeout_id = 0;
+  bench->failures++;
+
+  g_printerr ("The status menu did not show up within %d ms\n", TAP_TIMEOUT);
+
+  finish_tap (bench);
+
+  return FALSE;
+}
+
+/* Press and release in the middle of the status area, as a finger
+ * tap would. The server delivers the events like real input. */
+static gboolean
+tap_cb (HDTapBench *bench)
+{
+  Display *dpy = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+  GtkWidget *status_area = bench->status_area;
+  gint x, y;
+
+  gdk_window_get_origin (status_area->window, &x, &y);
+  x += status_area->allocation.width / 2;
+  y += status_area->allocation.height / 2;
+
+  XTestFakeMotionEvent (dpy, DefaultScreen (dpy), x, y, CurrentTime);
+  XTestFakeButtonEvent (dpy, 1, True, CurrentTime);
+  XSync (dpy, False);
+
+  bench->mapped = FALSE;
+  bench->exposed = FALSE;
+
+  XTestFakeButtonEvent (dpy, 1, False, CurrentTime);
+  XFlush (dpy);
+  bench->release_time = hd_bench_get_time_us ();
+
+  bench->timeout_id = g_timeout_add (TAP_TIMEOUT,
+                                     (GSourceFunc) tap_timeout_cb, bench);
+
+  return FALSE;
+}
+
+static gboolean
+map_event_cb (GtkWidget  *widget,
+              GdkEvent   *event,
+              HDTapBench *bench)
+{
+  if (bench->release_time && !bench->mapped)
+    {
+      bench->mapped = TRUE;
+      hd_bench_series_add (bench->series[bench->cold ? SERIES_COLD_MAP : SERIES_MAP],
+                           get_elapsed_ms (bench), 0);
+    }
+
+  return FALSE;
+}
+
+/* Runs after the expose has been dispatched and the double buffer
+ * copied; the sync waits until the server has drawn it */
+static gboolean
+expose_done_cb (HDTapBench *bench)
+{
+  bench->expose_done_id = 0;
+
+  hd_bench_flush ();
+
+  hd_bench_series_add (bench->series[bench->cold ? SERIES_COLD_EXPOSE : SERIES_EXPOSE],
+                       get_elapsed_ms (bench), 0);
+
+  finish_tap (bench);
+
+  return FALSE;
+}
+
+static gboolean
+expose_event_cb (GtkWidget      *widget,
+                 GdkEventExpose *event,
+                 HDTapBench     *bench)
+{
+  if (bench->mapped && !bench->exposed)
+    {
+      bench->exposed = TRUE;
+      bench->expose_done_id = g_idle_add_full (G_PRIORITY_HIGH,
+                                               (GSourceFunc) expose_done_cb,
+                                               bench, NULL);
+    }
+
+  return FALSE;
+}
+
+static void
+write_report (HDTapBench *bench,
+              FILE       *file)
+{
+  GdkScreen *screen = gdk_screen_get_default ();
+  gint width = gdk_screen_get_width (screen);
+  gint height = gdk_screen_get_height (screen);
+  guint i;
+
+  fprintf (file, "{\n");
+  fprintf (file, "  \"benchmark\": \"tap-to-visible\",\n");
+  fprintf (file, "  \"config\": { \"orientation\": \"%s\", \"screen\": \"%dx%d\", "
+           "\"items\": %d, \"taps\": %d },\n",
+           height > width ? "portrait" : "landscape", width, height,
+           n_items, n_taps);
+  fprintf (file, "  \"failures\": %u,\n", bench->failures);
+  fprintf (file, "  \"series\": {\n");
+  for (i = 0; i < N_SERIES; i++)
+    {
+      hd_bench_series_write_json (bench->series[i], file);
+      fprintf (file, i + 1 < N_SERIES ? ",\n" : "\n");
+    }
+  fprintf (file, "  }\n");
+  fprintf (file, "}\n");
+}
+
+int
+main (int argc, char **argv)
+{
+  HDTapBench bench = { 0, };
+  GOptionContext *context;
+  GError *error = NULL;
+  GKeyFile *keyfile;
+  FILE *file = stdout;
+  int event_base, error_base, major, minor;
+  guint i;
+
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
+  context = g_option_context_new ("- benchmark the status menu tap to visible latency");
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_group (context, gtk_get_option_group (TRUE));
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (context);
+
+  hildon_init ();
+
+  if (!XTestQueryExtension (GDK_DISPLAY_XDISPLAY (gdk_display_get_default ()),
+                            &event_base, &error_base, &major, &minor))
+    {
+      g_printerr ("The X server does not support the XTEST extension\n");
+      return 1;
+    }
+
+  for (i = 0; i < N_SERIES; i++)
+    bench.series[i] = hd_bench_series_new (series_names[i]);
+  bench.plugins = g_ptr_array_new ();
+  bench.loop = g_main_loop_new (NULL, FALSE);
+  bench.taps_left = MAX (n_taps, 1);
+  bench.cold = TRUE;
+
+  /* A plugin manager without plugins, the synthetic plugins are added
+   * by emitting its signals */
+  bench.plugin_manager = hd_plugin_manager_new (hd_config_file_new (g_get_tmp_dir (),
+                                                                    NULL,
+                                                                    "hd-tap-bench.conf"));
+
+  keyfile = create_plugin_configuration ();
+  hd_status_menu_config_load (keyfile);
+
+  bench.status_area = hd_status_area_new (bench.plugin_manager);
+  gtk_widget_show (bench.status_area);
+
+  bench.status_menu = hd_bench_find_status_menu ();
+  if (!bench.status_menu)
+    {
+      g_printerr ("The status area has no status menu\n");
+      return 1;
+    }
+
+  g_signal_connect (bench.status_menu, "map-event",
+                    G_CALLBACK (map_event_cb), &bench);
+  g_signal_connect_after (bench.status_menu, "expose-event",
+                          G_CALLBACK (expose_event_cb), &bench);
+
+  add_plugins (&bench);
+  hd_bench_flush ();
+
+  /* The first tap is the cold one, then n_taps warm ones */
+  g_timeout_add (CLOSE_SETTLE_DELAY, (GSourceFunc) tap_cb, &bench);
+
+  g_main_loop_run (bench.loop);
+
+  if (output)
+    {
+      file = fopen (output, "w");
+      if (!file)
+        {
+          g_printerr ("Could not open %s\n", output);
+          return 1;
+        }
+    }
+
+  write_report (&bench, file);
+
+  if (file != stdout)
+    fclose (file);
+
+  gtk_widget_destroy (bench.status_area);
+  g_key_file_free (keyfile);
+
+  return bench.failures ? 2 : 0;
+}
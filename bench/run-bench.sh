@@ -0,0 +1,48 @@
+#!/bin/sh
+#
+# Runs a benchmark under Xvfb with private session and system D-Bus
+# daemons, so it neither needs nor disturbs a running desktop.
+#
+# Usage: run-bench.sh BENCHMARK [ARGS...]
+
+set -e
+
+srcdir=`dirname "$0"`
+bench="$1"
+shift
+
+display=${BENCH_DISPLAY:-:42}
+
+# N900 screen size, 480x800x24 for portrait
+screen=${BENCH_SCREEN:-800x480x24}
+
+pids=
+cleanup ()
+{
+  for pid in $pids; do
+    kill $pid 2>/dev/null || true
+  done
+}
+trap cleanup EXIT INT TERM
+
+Xvfb $display -screen 0 $screen -nolisten tcp >/dev/null 2>&1 &
+pids="$pids $!"
+
+# Wait until the server accepts connections
+for i in 1 2 3 4 5 6 7 8 9 10; do
+  xdpyinfo -display $display >/dev/null 2>&1 && break
+  sleep 0.5
+done
+
+session=`dbus-daemon --session --fork --print-address=1 --print-pid=1`
+DBUS_SESSION_BUS_ADDRESS=`echo "$session" | sed -n 1p`
+pids="$pids `echo "$session" | sed -n 2p`"
+
+system=`dbus-daemon --config-file="$srcdir/system-bus.conf" --fork --print-address=1 --print-pid=1`
+DBUS_SYSTEM_BUS_ADDRESS=`echo "$system" | sed -n 1p`
+pids="$pids `echo "$system" | sed -n 2p`"
+
+DISPLAY=$display
+export DISPLAY DBUS_SESSION_BUS_ADDRESS DBUS_SYSTEM_BUS_ADDRESS
+
+"$bench" "$@"
@@ -0,0 +1,56 @@
+#!/bin/sh
+#
+# Runs each hd-callgrind-bench scenario under callgrind with the cache
+# simulator and writes the instruction counts and simulated cache
+# misses of the measured parts as metrics for compare-perf.sh. Unlike
+# wall clock times they are stable on a loaded machine.
+#
+# Usage: run-callgrind.sh BENCHMARK OUTPUT [SCENARIO...]
+
+set -e
+
+srcdir=`cd \`dirname "$0"\` && pwd`
+bench="$1"
+output="$2"
+shift 2
+
+scenarios=${*:-plugin-load icon-burst visibility-flip rotation menu}
+
+if ! command -v valgrind >/dev/null 2>&1; then
+  echo "valgrind not found, the callgrind metrics need it" >&2
+  exit 1
+fi
+
+workdir=`mktemp -d`
+trap 'rm -rf "$workdir"' EXIT
+
+echo "{" > "$output"
+separator=
+for scenario in $scenarios; do
+  "$srcdir/run-bench.sh" valgrind --tool=callgrind --cache-sim=yes \
+    --collect-atstart=no --callgrind-out-file="$workdir/$scenario.out" \
+    "$bench" --scenario $scenario $CALLGRIND_BENCH_ARGS 2>"$workdir/$scenario.log" || {
+      cat "$workdir/$scenario.log" >&2
+      exit 1
+    }
+
+  printf "$separator" >> "$output"
+  awk -v name=`echo $scenario | tr - _` '
+    /^events:/ { for (i = 2; i <= NF; i++) event[$i] = i }
+    /^(summary|totals):/ {
+      for (e in event) value[e] = $(event[e])
+    }
+    END {
+      # Nothing was collected, e.g. the collection was never toggled on
+      if (!value["Ir"]) {
+        printf "%s: no instructions collected\n", name > "/dev/stderr"
+        exit 1
+      }
+      printf "  \"%s_ir\": %.0f,\n", name, value["Ir"]
+      printf "  \"%s_l1_misses\": %.0f,\n", name, value["I1mr"] + value["D1mr"] + value["D1mw"]
+      printf "  \"%s_ll_misses\": %.0f", name, value["ILmr"] + value["DLmr"] + value["DLmw"]
+    }
+  ' "$workdir/$scenario.out" >> "$output"
+  separator=",\n"
+done
+printf "\n}\n" >> "$output"
@@ -0,0 +1,45 @@
+#!/bin/sh
+#
+# Runs hd-scaling-bench for each plugin count and writes the reports
+# as one JSON array, with a summary on stderr. A per-plugin cost that
+# grows with N means superlinear scaling.
+#
+# Usage: run-scaling.sh BENCHMARK MODULE OUTPUT [N...]
+
+set -e
+
+srcdir=`cd \`dirname "$0"\` && pwd`
+bench="$1"
+module="$2"
+output="$3"
+shift 3
+
+counts=${*:-10 100 1000}
+workdir=`mktemp -d`
+trap 'rm -rf "$workdir"' EXIT
+
+echo "[" > "$output"
+separator=
+for n in $counts; do
+  "$srcdir/gen-plugins.sh" $n "$workdir/plugins-$n" "$module"
+  "$srcdir/run-bench.sh" "$bench" --conf-dir "$workdir/plugins-$n" \
+    --output "$workdir/report-$n.json"
+
+  printf "$separator" >> "$output"
+  cat "$workdir/report-$n.json" >> "$output"
+  separator=","
+done
+echo "]" >> "$output"
+
+# manager_run_ms_per_plugin and the layout means should stay flat
+printf "%8s %14s %16s %18s %18s %14s\n" \
+  plugins run_ms run_ms/plugin area_layout_ms menu_layout_ms menu_open_ms >&2
+awk '
+  /"plugins":/         { match ($0, /"plugins": [0-9]+/); n = substr ($0, RSTART + 11, RLENGTH - 11) }
+  /"manager_run_ms":/  { run = $2 + 0 }
+  /"manager_run_ms_per_plugin":/ { per = $2 + 0 }
+  /"area_box_layout":/ { match ($0, /"mean_ms": [0-9.]+/); area = substr ($0, RSTART + 11, RLENGTH - 11) }
+  /"menu_box_layout":/ { match ($0, /"mean_ms": [0-9.]+/); menu = substr ($0, RSTART + 11, RLENGTH - 11) }
+  /"menu_open":/       { match ($0, /"p50_ms": [0-9.]+/); open = substr ($0, RSTART + 10, RLENGTH - 10);
+                         printf "%8d %14.1f %16.4f %18.4f %18.4f %14.2f\n", n, run, per, area, menu, open }
+' "$output" >&2
@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# Runs hd-tap-bench in landscape and portrait for each menu item count
+# and writes the reports as one JSON array, with a summary on stderr.
+#
+# Usage: run-tap.sh BENCHMARK OUTPUT [ITEMS...]
+
+set -e
+
+srcdir=`cd \`dirname "$0"\` && pwd`
+bench="$1"
+output="$2"
+shift 2
+
+items=${*:-5 20 60}
+workdir=`mktemp -d`
+trap 'rm -rf "$workdir"' EXIT
+
+echo "[" > "$output"
+separator=
+for screen in 800x480x24 480x800x24; do
+  for n in $items; do
+    BENCH_SCREEN=$screen "$srcdir/run-bench.sh" "$bench" --items $n \
+      --output "$workdir/report.json"
+
+    printf "$separator" >> "$output"
+    cat "$workdir/report.json" >> "$output"
+    separator=","
+  done
+done
+echo "]" >> "$output"
+
+printf "%-10s %6s %12s %12s %15s %15s %9s\n" \
+  layout items cold_map_ms cold_draw_ms map_p50/p90_ms draw_p50/p90_ms failures >&2
+awk '
+  function field(name,   v) { if (match ($0, "\"" name "\": [0-9.]+")) { v = substr ($0, RSTART, RLENGTH); sub (/.*: /, "", v); return v } return 0 }
+  /"orientation":/        { match ($0, /"orientation": "[a-z]+"/); layout = substr ($0, RSTART + 16, RLENGTH - 17); items = field("items") }
+  /"failures":/           { failures = field("failures") }
+  /"cold_tap_to_map":/    { cold_map = field("p50_ms") }
+  /"cold_tap_to_expose":/ { cold_draw = field("p50_ms") }
+  /"tap_to_map":/         { map = sprintf ("%.1f/%.1f", field("p50_ms"), field("p90_ms")) }
+  /"tap_to_expose":/      { draw = sprintf ("%.1f/%.1f", field("p50_ms"), field("p90_ms"));
+                            printf "%-10s %6d %12.1f %12.1f %15s %15s %9d\n", layout, items, cold_map, cold_draw, map, draw, failures }
+' "$output" >&2
@@ -27,6 +27,7 @@
 #include <gdk/gdkx.h>
 
 #include "hd-desktop.h"
+#include "hd-x-stats.h"
 
 #define HD_DESKTOP_GET_PRIVATE(object) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((object), HD_TYPE_DESKTOP, HDDesktopPrivate))
@@ -142,19 +143,25 @@ filter_property_changed (GdkXEvent *xevent,
           int actual_format;
           unsigned long nitems, bytes;
           unsigned char *atom_data = NULL;
-
-          if (XGetWindowProperty (GDK_WINDOW_XDISPLAY (priv->root_window),
-                                  GDK_WINDOW_XID (priv->root_window),
-                                  gdk_x11_get_xatom_by_name ("_MB_CURRENT_APP_WINDOW"),
-                                  0,
-                                  (~0L),
-                                  False,
-                                  AnyPropertyType,
-                                  &actual_type,
-                                  &actual_format,
-                                  &nitems,
-                                  &bytes,
-                                  &atom_data) == Success)
+          HDXStatsSection section;
+          int result;
+
+          hd_x_stats_begin (&section);
+          result = XGetWindowProperty (GDK_WINDOW_XDISPLAY (priv->root_window),
+                                       GDK_WINDOW_XID (priv->root_window),
+                                       gdk_x11_get_xatom_by_name ("_MB_CURRENT_APP_WINDOW"),
+                                       0,
+                                       (~0L),
+                                       False,
+                                       AnyPropertyType,
+                                       &actual_type,
+                                       &actual_format,
+                                       &nitems,
+                                       &bytes,
+                                       &atom_data);
+          hd_x_stats_end (&section, "desktop:get-current-app-window");
+
+          if (result == Success)
             {
               if (nitems == 1) {
                   guint32 *new_value = (void *) atom_data;
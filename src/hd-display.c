@@ -34,15 +34,20 @@
 #include <string.h>
 
 #include "hd-display.h"
+#include "hd-system-bus.h"
 
 #define HD_DISPLAY_GET_PRIVATE(object) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((object), HD_TYPE_DISPLAY, HDDisplayPrivate))
 
 struct _HDDisplayPrivate
 {
-  DBusConnection *system_bus;
+  HDSystemBus *system_bus;
+  guint display_signal_id;
 
-  gboolean display_on : 1;
+  /* MCE display status request sent at startup */
+  DBusPendingCall *status_query;
+
+  HDDisplayState state;
 };
 
 enum
@@ -57,9 +62,6 @@ static guint display_signals[LAST_SIGNAL] = { 0, };
 static void hd_display_dispose     (GObject *object);
 
 static void initialize_system_dbus (HDDisplay *display);
-static DBusHandlerResult system_bus_signal_filter (DBusConnection *system_bus,
-                                                   DBusMessage    *msg,
-                                                   void           *data);
 
 G_DEFINE_TYPE (HDDisplay, hd_display, G_TYPE_OBJECT);
 
@@ -104,85 +106,159 @@ hd_display_init (HDDisplay *display)
 {
   display->priv = HD_DISPLAY_GET_PRIVATE (display);
 
-  display->priv->display_on = TRUE;
+  display->priv->state = HD_DISPLAY_STATE_ON;
 
   initialize_system_dbus (display);
 }
 
+#ifdef HAVE_DSME
 static void
-initialize_system_dbus (HDDisplay *display)
+set_display_status (HDDisplay  *display,
+                    const char *value)
 {
   HDDisplayPrivate *priv = display->priv;
-  DBusError error;
+  HDDisplayState state;
+
+  if (strcmp (value, MCE_DISPLAY_ON_STRING) == 0)
+    state = HD_DISPLAY_STATE_ON;
+  else if (strcmp (value, MCE_DISPLAY_DIM_STRING) == 0)
+    state = HD_DISPLAY_STATE_DIM;
+  else if (strcmp (value, MCE_DISPLAY_OFF_STRING) == 0)
+    state = HD_DISPLAY_STATE_OFF;
+  else
+    {
+      g_warning ("%s. Unknown display status %s",
+                 __FUNCTION__,
+                 value);
+      state = HD_DISPLAY_STATE_ON;
+    }
 
-  dbus_error_init (&error);
-  priv->system_bus = dbus_bus_get (DBUS_BUS_SYSTEM,
-                                   &error);
-  if (dbus_error_is_set (&error))
-   {
-     g_warning ("%s. Could not connect to System D_Bus. %s",
-                __FUNCTION__,
-                error.message);
-     dbus_error_free (&error);
-     return;
-   }
+  if (priv->state != state)
+    {
+      priv->state = state;
 
-#ifdef HAVE_DSME
-  dbus_bus_add_match (priv->system_bus,
-                      "type='signal', interface='" MCE_SIGNAL_IF "'",
-                      NULL);
-#endif
-  dbus_connection_add_filter (priv->system_bus,
-                              system_bus_signal_filter,
-                              display,
-                              NULL);
+      g_signal_emit (display,
+                     display_signals[DISPLAY_STATUS_CHANGED],
+                     0);
+    }
 }
 
-static DBusHandlerResult
-system_bus_signal_filter (DBusConnection *system_bus,
-                          DBusMessage    *msg,
-                          void           *data)
+static void
+cancel_display_status_query (HDDisplay *display)
+{
+  HDDisplayPrivate *priv = display->priv;
+
+  if (priv->status_query)
+    {
+      dbus_pending_call_cancel (priv->status_query);
+      dbus_pending_call_unref (priv->status_query);
+      priv->status_query = NULL;
+    }
+}
+
+static void
+display_signal_cb (DBusMessage *msg,
+                   gpointer     data)
+{
+  HDDisplay *display = data;
+  DBusMessageIter iter;
+
+  /* The signal is newer than any pending reply */
+  cancel_display_status_query (display);
+
+  if (dbus_message_iter_init (msg, &iter))
+    if (dbus_message_iter_get_arg_type (&iter) == DBUS_TYPE_STRING)
+      {
+        const char *value;
+
+        dbus_message_iter_get_basic(&iter, &value);
+        set_display_status (display, value);
+      }
+}
+
+static void
+display_status_reply_cb (DBusPendingCall *pending,
+                         void            *data)
 {
-#ifdef HAVE_DSME
   HDDisplay *display = data;
   HDDisplayPrivate *priv = display->priv;
+  DBusMessage *reply;
+  DBusError error;
+  const char *value;
 
-  if (dbus_message_is_signal (msg,
-                              MCE_SIGNAL_IF,
-                              MCE_DISPLAY_SIG))
+  reply = dbus_pending_call_steal_reply (pending);
+
+  dbus_pending_call_unref (priv->status_query);
+  priv->status_query = NULL;
+
+  if (!reply)
+    return;
+
+  dbus_error_init (&error);
+  if (dbus_set_error_from_message (&error, reply) ||
+      !dbus_message_get_args (reply, &error,
+                              DBUS_TYPE_STRING, &value,
+                              DBUS_TYPE_INVALID))
     {
-      DBusMessageIter iter;
-
-      if (dbus_message_iter_init (msg, &iter))
-        if (dbus_message_iter_get_arg_type (&iter) == DBUS_TYPE_STRING)
-          {
-            const char *value;
-            gboolean display_on = TRUE;
-
-            dbus_message_iter_get_basic(&iter, &value);
-            if (strcmp (value, MCE_DISPLAY_ON_STRING) == 0)
-              display_on = TRUE;
-            else if (strcmp (value, MCE_DISPLAY_DIM_STRING) == 0)
-              display_on = TRUE;
-            else if (strcmp (value, MCE_DISPLAY_OFF_STRING) == 0)
-              display_on = FALSE;
-            else
-              g_warning ("%s. Unknown value %s for signal %s.%s",
-                         __FUNCTION__,
-                         value,
-                         MCE_SIGNAL_IF,
-                         MCE_DISPLAY_SIG);
-
-            priv->display_on = display_on;
-
-            g_signal_emit (display,
-                           display_signals[DISPLAY_STATUS_CHANGED],
-                           0);
-          }
-     }
+      g_warning ("%s. Could not get display status. %s",
+                 __FUNCTION__,
+                 error.message);
+      dbus_error_free (&error);
+    }
+  else
+    set_display_status (display, value);
+
+  dbus_message_unref (reply);
+}
+
+/* Ask MCE for the current display status instead of assuming the
+ * display is on, without blocking startup on the reply */
+static void
+query_display_status (HDDisplay *display)
+{
+  HDDisplayPrivate *priv = display->priv;
+  DBusConnection *connection;
+  DBusMessage *msg;
+
+  connection = hd_system_bus_get_connection (priv->system_bus);
+  if (!connection)
+    return;
+
+  msg = dbus_message_new_method_call (MCE_SERVICE,
+                                      MCE_REQUEST_PATH,
+                                      MCE_REQUEST_IF,
+                                      MCE_DISPLAY_STATUS_GET);
+  if (!msg)
+    return;
+
+  if (dbus_connection_send_with_reply (connection, msg,
+                                       &priv->status_query, -1) &&
+      priv->status_query)
+    dbus_pending_call_set_notify (priv->status_query,
+                                  display_status_reply_cb,
+                                  display,
+                                  NULL);
+
+  dbus_message_unref (msg);
+}
 #endif
 
-  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+static void
+initialize_system_dbus (HDDisplay *display)
+{
+  HDDisplayPrivate *priv = display->priv;
+
+  priv->system_bus = hd_system_bus_get ();
+
+#ifdef HAVE_DSME
+  priv->display_signal_id = hd_system_bus_add_signal_handler (priv->system_bus,
+                                                              MCE_SIGNAL_IF,
+                                                              MCE_DISPLAY_SIG,
+                                                              display_signal_cb,
+                                                              display);
+
+  query_display_status (display);
+#endif
 }
 
 static void
@@ -191,16 +267,18 @@ hd_display_dispose (GObject *object)
   HDDisplay *display = HD_DISPLAY (object);
   HDDisplayPrivate *priv = display->priv;
 
-  if (priv->system_bus)
-    {
 #ifdef HAVE_DSME
-      dbus_bus_remove_match (priv->system_bus,
-                             "type='signal', interface='" MCE_SIGNAL_IF "'",
-                             NULL);
+  cancel_display_status_query (display);
 #endif
-      dbus_connection_remove_filter (priv->system_bus,
-                                     system_bus_signal_filter,
-                                     display);
+
+  if (priv->system_bus)
+    {
+      if (priv->display_signal_id)
+        hd_system_bus_remove_signal_handler (priv->system_bus,
+                                             priv->display_signal_id);
+      priv->display_signal_id = 0;
+
+      g_object_unref (priv->system_bus);
       priv->system_bus = NULL;
     }
 
@@ -216,5 +294,14 @@ hd_display_is_on (HDDisplay *display)
 
   priv = display->priv;
 
-  return priv->display_on;
+  /* A dimmed display is still visible */
+  return priv->state != HD_DISPLAY_STATE_OFF;
+}
+
+HDDisplayState
+hd_display_get_state (HDDisplay *display)
+{
+  g_return_val_if_fail (HD_IS_DISPLAY (display), HD_DISPLAY_STATE_ON);
+
+  return display->priv->state;
 }
@@ -38,6 +38,15 @@ typedef struct _HDDisplay        HDDisplay;
 typedef struct _HDDisplayClass   HDDisplayClass;
 typedef struct _HDDisplayPrivate HDDisplayPrivate;
 
+typedef enum
+{
+  HD_DISPLAY_STATE_ON,
+  HD_DISPLAY_STATE_DIM,
+  HD_DISPLAY_STATE_OFF,
+
+  HD_DISPLAY_N_STATES
+} HDDisplayState;
+
 struct _HDDisplay
 {
   GObject parent;
@@ -50,11 +59,12 @@ struct _HDDisplayClass
   GObjectClass parent;
 };
 
-GType      hd_display_get_type   (void);
+GType          hd_display_get_type   (void);
 
-HDDisplay *hd_display_get        (void);
+HDDisplay     *hd_display_get        (void);
 
-gboolean   hd_display_is_on      (HDDisplay *display);
+gboolean       hd_display_is_on      (HDDisplay *display);
+HDDisplayState hd_display_get_state  (HDDisplay *display);
 
 G_END_DECLS
 
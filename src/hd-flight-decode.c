@@ -0,0 +1,148 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/* Prints the events of a flight recorder file, e.g. a .snapshot or the
+ * .previous file of a run which froze or crashed, as a timeline. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "hd-flight-recorder.h"
+
+static const gchar *event_names[HD_FLIGHT_N_EVENTS] =
+{
+  "?",
+  "stall",
+  "layout",
+  "x-round-trip",
+  "plugin-dispatch"
+};
+
+static gint
+compare_seq (gconstpointer a,
+             gconstpointer b)
+{
+  const HDFlightRecorderEntry *ea = *(HDFlightRecorderEntry * const *) a;
+  const HDFlightRecorderEntry *eb = *(HDFlightRecorderEntry * const *) b;
+
+  return ea->seq < eb->seq ? -1 : ea->seq > eb->seq;
+}
+
+static void
+print_entry (const HDFlightRecorderHeader *header,
+             const HDFlightRecorderEntry  *entry,
+             gint64                        previous_ns)
+{
+  gint64 realtime_ns = header->realtime_base_ns +
+                       (entry->time_ns - header->monotonic_base_ns);
+  time_t seconds = realtime_ns / 1000000000;
+  gchar date[32];
+  gchar tag[sizeof (entry->tag) + 1];
+
+  strftime (date, sizeof (date), "%Y-%m-%d %H:%M:%S", localtime (&seconds));
+
+  memcpy (tag, entry->tag, sizeof (entry->tag));
+  tag[sizeof (entry->tag)] = '\0';
+
+  printf ("%s.%03d %+10.1f  %-16s %10.1f ms %8u  %s\n",
+          date,
+          (gint) (realtime_ns / 1000000 % 1000),
+          previous_ns ? (entry->time_ns - previous_ns) / 1000000.0 : 0.0,
+          entry->type < HD_FLIGHT_N_EVENTS ? event_names[entry->type] : "?",
+          entry->duration_us / 1000.0,
+          entry->value,
+          tag);
+}
+
+int
+main (int argc, char **argv)
+{
+  const HDFlightRecorderHeader *header;
+  const HDFlightRecorderEntry *entries;
+  GPtrArray *valid;
+  GError *error = NULL;
+  gchar *contents;
+  gsize length;
+  gint64 previous_ns = 0;
+  guint32 i;
+
+  if (argc != 2)
+    {
+      g_printerr ("Usage: %s FILE\n", argv[0]);
+      return 1;
+    }
+
+  if (!g_file_get_contents (argv[1], &contents, &length, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+
+  header = (const HDFlightRecorderHeader *) contents;
+  if (length < sizeof (HDFlightRecorderHeader) ||
+      memcmp (header->magic, HD_FLIGHT_RECORDER_MAGIC, sizeof (header->magic)) ||
+      header->version != HD_FLIGHT_RECORDER_VERSION ||
+      header->entry_size != sizeof (HDFlightRecorderEntry) ||
+      length < sizeof (HDFlightRecorderHeader) +
+               (gsize) header->n_entries * sizeof (HDFlightRecorderEntry))
+    {
+      g_printerr ("%s is not a flight recorder file of version %d\n",
+                  argv[1], HD_FLIGHT_RECORDER_VERSION);
+      return 1;
+    }
+
+  entries = (const HDFlightRecorderEntry *) (header + 1);
+
+  /* Entries which were being written, or never, have a sequence number
+   * which does not belong to their slot */
+  valid = g_ptr_array_new ();
+  for (i = 0; i < header->n_entries; i++)
+    if (entries[i].seq && (entries[i].seq - 1) % header->n_entries == i)
+      g_ptr_array_add (valid, (gpointer) &entries[i]);
+
+  g_ptr_array_sort (valid, compare_seq);
+
+  printf ("pid %u, %u of %u entries, %u events recorded\n",
+          header->pid, valid->len, header->n_entries, (guint32) header->next);
+  printf ("%-23s %10s  %-16s %13s %8s  %s\n",
+          "time", "delta ms", "event", "duration", "value", "tag");
+
+  for (i = 0; i < valid->len; i++)
+    {
+      const HDFlightRecorderEntry *entry = g_ptr_array_index (valid, i);
+
+      print_entry (header, entry, previous_ns);
+      previous_ns = entry->time_ns;
+    }
+
+  g_ptr_array_free (valid, TRUE);
+  g_free (contents);
+
+  return 0;
+}
@@ -0,0 +1,341 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hd-flight-recorder.h"
+
+/* Main loop iterations which dispatch for longer are recorded */
+#define STALL_THRESHOLD_MS 100
+
+/* Layout passes which take longer are recorded, the fast ones would
+ * only push the interesting events out of the ring */
+#define LAYOUT_THRESHOLD_US 5000
+
+/* An event this long copies the ring to a snapshot file */
+#define DEFAULT_SNAPSHOT_THRESHOLD_MS 1000
+
+/* Later slow events within this time do not overwrite the snapshot */
+#define MIN_SNAPSHOT_INTERVAL 60
+
+/* NULL until hd_flight_recorder_open () succeeded */
+static HDFlightRecorderHeader *header = NULL;
+static HDFlightRecorderEntry *entries = NULL;
+static gsize mapping_size = 0;
+
+static gchar *snapshot_filename = NULL;
+static guint32 snapshot_threshold_us = DEFAULT_SNAPSHOT_THRESHOLD_MS * 1000;
+static gint64 last_snapshot = 0;
+static volatile gint snapshot_pending = 0;
+
+static gint64
+get_time_ns (clockid_t clock)
+{
+  struct timespec ts;
+
+  clock_gettime (clock, &ts);
+
+  return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* The ring of the previous run is what a freeze or crash report needs,
+ * it is moved away instead of being overwritten */
+static void
+keep_previous_run (const gchar *filename)
+{
+  gchar *previous = g_strconcat (filename, ".previous", NULL);
+
+  if (rename (filename, previous) == -1 && errno != ENOENT)
+    g_warning ("%s. Could not rename %s. %s",
+               __FUNCTION__,
+               filename,
+               g_strerror (errno));
+
+  g_free (previous);
+}
+
+/**
+ * hd_flight_recorder_open:
+ * @filename: the ring file
+ *
+ * Maps a fixed size ring file of performance events. The mapping is
+ * shared, so the events written so far are in the page cache even if
+ * the process is killed.
+ *
+ * Returns: %TRUE if events are recorded from now on
+ **/
+gboolean
+hd_flight_recorder_open (const gchar *filename)
+{
+  const gchar *threshold;
+  gchar *dir;
+  void *mapping;
+  int fd;
+
+  g_return_val_if_fail (header == NULL, FALSE);
+
+  dir = g_path_get_dirname (filename);
+  g_mkdir_with_parents (dir, 0755);
+  g_free (dir);
+
+  keep_previous_run (filename);
+
+  mapping_size = sizeof (HDFlightRecorderHeader) +
+                 HD_FLIGHT_RECORDER_ENTRIES * sizeof (HDFlightRecorderEntry);
+
+  fd = open (filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1 || ftruncate (fd, mapping_size) == -1)
+    {
+      g_warning ("%s. Could not create %s. %s",
+                 __FUNCTION__,
+                 filename,
+                 g_strerror (errno));
+      if (fd != -1)
+        close (fd);
+      return FALSE;
+    }
+
+  mapping = mmap (NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+
+  if (mapping == MAP_FAILED)
+    {
+      g_warning ("%s. Could not map %s. %s",
+                 __FUNCTION__,
+                 filename,
+                 g_strerror (errno));
+      return FALSE;
+    }
+
+  /* ftruncate () filled the file with zeros, all entries are empty */
+  header = mapping;
+  memcpy (header->magic, HD_FLIGHT_RECORDER_MAGIC, sizeof (header->magic));
+  header->version = HD_FLIGHT_RECORDER_VERSION;
+  header->entry_size = sizeof (HDFlightRecorderEntry);
+  header->n_entries = HD_FLIGHT_RECORDER_ENTRIES;
+  header->monotonic_base_ns = get_time_ns (CLOCK_MONOTONIC);
+  header->realtime_base_ns = get_time_ns (CLOCK_REALTIME);
+  header->pid = getpid ();
+
+  snapshot_filename = g_strconcat (filename, ".snapshot", NULL);
+
+  threshold = g_getenv (HD_FLIGHT_RECORDER_THRESHOLD_ENV);
+  if (threshold && atoi (threshold) > 0)
+    snapshot_threshold_us = atoi (threshold) * 1000;
+
+  /* Published last, writers check for it */
+  g_atomic_pointer_set ((gpointer *) &entries,
+                        (HDFlightRecorderEntry *) (header + 1));
+
+  return TRUE;
+}
+
+static gboolean
+snapshot_cb (gpointer data)
+{
+  GError *error = NULL;
+  gint64 now = get_time_ns (CLOCK_MONOTONIC);
+
+  g_atomic_int_set (&snapshot_pending, 0);
+
+  if (last_snapshot && now - last_snapshot < (gint64) MIN_SNAPSHOT_INTERVAL * 1000000000)
+    return FALSE;
+
+  last_snapshot = now;
+
+  /* Written to a temporary file and renamed, a snapshot is complete */
+  if (!g_file_set_contents (snapshot_filename, (const gchar *) header,
+                            mapping_size, &error))
+    {
+      g_warning ("%s. Could not write the snapshot. %s",
+                 __FUNCTION__,
+                 error->message);
+      g_error_free (error);
+    }
+
+  return FALSE;
+}
+
+/**
+ * hd_flight_recorder_record:
+ * @type: the kind of event
+ * @duration_us: how long it took
+ * @value: a number depending on @type
+ * @tag: a short string depending on @type or %NULL
+ *
+ * Appends an event to the ring, from any thread. Slots are claimed with
+ * an atomic increment; the sequence number of an entry is written
+ * last, so the decoder skips entries which were being written.
+ **/
+void
+hd_flight_recorder_record (HDFlightEventType  type,
+                           guint32            duration_us,
+                           guint32            value,
+                           const gchar       *tag)
+{
+  HDFlightRecorderEntry *entry, *ring = g_atomic_pointer_get ((gpointer *) &entries);
+  guint32 index;
+
+  if (!ring)
+    return;
+
+  index = (guint32) g_atomic_int_exchange_and_add (&header->next, 1);
+  entry = &ring[index % HD_FLIGHT_RECORDER_ENTRIES];
+
+  g_atomic_int_set ((volatile gint *) &entry->seq, 0);
+
+  entry->time_ns = get_time_ns (CLOCK_MONOTONIC);
+  entry->type = type;
+  entry->duration_us = duration_us;
+  entry->value = value;
+  if (tag)
+    strncpy (entry->tag, tag, sizeof (entry->tag));
+  else
+    entry->tag[0] = '\0';
+
+  g_atomic_int_set ((volatile gint *) &entry->seq, index + 1);
+
+  if (duration_us >= snapshot_threshold_us &&
+      g_atomic_int_compare_and_exchange (&snapshot_pending, 0, 1))
+    g_idle_add_full (G_PRIORITY_HIGH, snapshot_cb, NULL, NULL);
+}
+
+/**
+ * hd_flight_recorder_begin:
+ *
+ * Returns: the start of an event, to be passed to
+ * hd_flight_recorder_end(). 0 if nothing is recorded.
+ **/
+gint64
+hd_flight_recorder_begin (void)
+{
+  if (!g_atomic_pointer_get ((gpointer *) &entries))
+    return 0;
+
+  return get_time_ns (CLOCK_MONOTONIC);
+}
+
+void
+hd_flight_recorder_end (HDFlightEventType  type,
+                        gint64             start,
+                        guint32            value,
+                        const gchar       *tag)
+{
+  gint64 duration;
+
+  if (!start)
+    return;
+
+  duration = (get_time_ns (CLOCK_MONOTONIC) - start) / 1000;
+
+  if (type == HD_FLIGHT_EVENT_LAYOUT && duration < LAYOUT_THRESHOLD_US)
+    return;
+
+  hd_flight_recorder_record (type, duration, value, tag);
+}
+
+/* Measures how long each main loop iteration dispatched without adding
+ * wakeups: check runs right after the poll, prepare of the next
+ * iteration right after the dispatching */
+typedef struct
+{
+  GSource source;
+  gint64  poll_end;
+} StallWatch;
+
+static gboolean
+stall_watch_prepare (GSource *source,
+                     gint    *timeout)
+{
+  StallWatch *watch = (StallWatch *) source;
+
+  *timeout = -1;
+
+  if (watch->poll_end)
+    {
+      gint64 busy = get_time_ns (CLOCK_MONOTONIC) - watch->poll_end;
+
+      if (busy >= (gint64) STALL_THRESHOLD_MS * 1000000)
+        hd_flight_recorder_record (HD_FLIGHT_EVENT_STALL, busy / 1000, 0, NULL);
+
+      watch->poll_end = 0;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+stall_watch_check (GSource *source)
+{
+  StallWatch *watch = (StallWatch *) source;
+
+  watch->poll_end = get_time_ns (CLOCK_MONOTONIC);
+
+  return FALSE;
+}
+
+static gboolean
+stall_watch_dispatch (GSource     *source,
+                      GSourceFunc  callback,
+                      gpointer     data)
+{
+  return TRUE;
+}
+
+static GSourceFuncs stall_watch_funcs =
+{
+  stall_watch_prepare,
+  stall_watch_check,
+  stall_watch_dispatch,
+  NULL
+};
+
+/**
+ * hd_flight_recorder_watch_main_loop:
+ *
+ * Records main loop iterations of the default context which dispatch
+ * for longer than 100 ms as stalls.
+ **/
+void
+hd_flight_recorder_watch_main_loop (void)
+{
+  GSource *source;
+
+  if (!g_atomic_pointer_get ((gpointer *) &entries))
+    return;
+
+  source = g_source_new (&stall_watch_funcs, sizeof (StallWatch));
+  g_source_attach (source, NULL);
+  g_source_unref (source);
+}
@@ -0,0 +1,104 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef __HD_FLIGHT_RECORDER_H__
+#define __HD_FLIGHT_RECORDER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The file is the shared mapping of a header and a ring of entries, it
+ * is read by hd-flight-decode after a freeze or a crash. Fixed size
+ * types only, the layout is the same on the device and the host. */
+
+#define HD_FLIGHT_RECORDER_MAGIC   "HDFLIGHT"
+#define HD_FLIGHT_RECORDER_VERSION 1
+
+/* Events kept, roughly the last minutes of a busy status menu */
+#define HD_FLIGHT_RECORDER_ENTRIES 8192
+
+/* Overrides the duration in ms which triggers a snapshot */
+#define HD_FLIGHT_RECORDER_THRESHOLD_ENV "HD_STATUS_MENU_FLIGHT_THRESHOLD_MS"
+
+typedef enum
+{
+  HD_FLIGHT_EVENT_STALL = 1,        /* main loop iteration, value: 0 */
+  HD_FLIGHT_EVENT_LAYOUT,           /* slow check_resize pass, tag: window */
+  HD_FLIGHT_EVENT_X_ROUND_TRIP,     /* value: requests, tag: code path */
+  HD_FLIGHT_EVENT_PLUGIN_DISPATCH,  /* CPU time, tag: plugin id */
+
+  HD_FLIGHT_N_EVENTS
+} HDFlightEventType;
+
+typedef struct _HDFlightRecorderHeader HDFlightRecorderHeader;
+typedef struct _HDFlightRecorderEntry  HDFlightRecorderEntry;
+
+struct _HDFlightRecorderHeader
+{
+  gchar    magic[8];
+  guint32  version;
+  guint32  entry_size;
+  guint32  n_entries;
+
+  /* index of the next entry, incremented atomically by writers */
+  volatile gint32 next;
+
+  /* CLOCK_MONOTONIC and CLOCK_REALTIME at the same instant, to show
+   * the entries in wall clock time */
+  gint64   monotonic_base_ns;
+  gint64   realtime_base_ns;
+
+  guint32  pid;
+  guint32  reserved[5];
+};
+
+struct _HDFlightRecorderEntry
+{
+  gint64   time_ns;   /* CLOCK_MONOTONIC at the end of the event */
+
+  /* index + 1 of the entry, 0 while it is written */
+  volatile guint32 seq;
+
+  guint16  type;
+  guint16  reserved;
+  guint32  duration_us;
+  guint32  value;
+  gchar    tag[24];   /* not nul terminated if the tag is longer */
+};
+
+gboolean hd_flight_recorder_open            (const gchar       *filename);
+void     hd_flight_recorder_watch_main_loop (void);
+
+gint64   hd_flight_recorder_begin           (void);
+void     hd_flight_recorder_end             (HDFlightEventType  type,
+                                             gint64             start,
+                                             guint32            value,
+                                             const gchar       *tag);
+void     hd_flight_recorder_record          (HDFlightEventType  type,
+                                             guint32            duration_us,
+                                             guint32            value,
+                                             const gchar       *tag);
+
+G_END_DECLS
+
+#endif
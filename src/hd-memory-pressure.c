@@ -0,0 +1,316 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_MALLOC_TRIM
+#include <malloc.h>
+#endif
+
+#include "hd-memory-pressure.h"
+#include "hd-display.h"
+
+#define HD_MEMORY_PRESSURE_GET_PRIVATE(object) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((object), HD_TYPE_MEMORY_PRESSURE, HDMemoryPressurePrivate))
+
+#define PSI_MEMORY_FILE "/proc/pressure/memory"
+
+/* Trigger when tasks were stalled on memory for 150 ms within 1 s */
+#define PSI_MEMORY_TRIGGER "some 150000 1000000"
+
+/* PSI triggers fire every window while the pressure lasts */
+#define MIN_TRIM_INTERVAL 30
+
+/* Trim once the display was off for this many seconds */
+#define DISPLAY_OFF_TRIM_DELAY 300
+
+struct _HDMemoryPressurePrivate
+{
+  int         psi_fd;
+  guint       psi_watch_id;
+
+  HDDisplay  *display;
+  guint       display_off_id;
+
+  GTimer     *last_trim;
+};
+
+enum
+{
+  TRIM,
+
+  LAST_SIGNAL
+};
+
+static guint memory_pressure_signals[LAST_SIGNAL] = { 0, };
+
+G_DEFINE_TYPE (HDMemoryPressure, hd_memory_pressure, G_TYPE_OBJECT);
+
+HDMemoryPressure *
+hd_memory_pressure_get (void)
+{
+  static gpointer memory_pressure = NULL;
+
+  if (memory_pressure == NULL)
+    {
+      memory_pressure = g_object_new (HD_TYPE_MEMORY_PRESSURE,
+                                      NULL);
+      g_object_add_weak_pointer (memory_pressure, &memory_pressure);
+      return memory_pressure;
+    }
+  else
+    {
+      return g_object_ref (memory_pressure);
+    }
+}
+
+static gboolean
+psi_event_cb (GIOChannel   *source,
+              GIOCondition  condition,
+              gpointer      data)
+{
+  HDMemoryPressure *memory_pressure = data;
+  HDMemoryPressurePrivate *priv = memory_pressure->priv;
+
+  if (condition & (G_IO_ERR | G_IO_HUP | G_IO_NVAL))
+    {
+      g_warning ("%s. Memory pressure trigger failed, no longer watched",
+                 __FUNCTION__);
+      priv->psi_watch_id = 0;
+      return FALSE;
+    }
+
+  if (g_timer_elapsed (priv->last_trim, NULL) >= MIN_TRIM_INTERVAL)
+    hd_memory_pressure_trim (memory_pressure, "memory pressure");
+
+  return TRUE;
+}
+
+/* Pressure stall information is only available with Linux >= 4.20 and
+ * CONFIG_PSI, without it trimming relies on the display state */
+static void
+watch_psi (HDMemoryPressure *memory_pressure)
+{
+  HDMemoryPressurePrivate *priv = memory_pressure->priv;
+  GIOChannel *channel;
+
+  priv->psi_fd = open (PSI_MEMORY_FILE, O_RDWR | O_NONBLOCK);
+  if (priv->psi_fd == -1)
+    return;
+
+  if (write (priv->psi_fd, PSI_MEMORY_TRIGGER, strlen (PSI_MEMORY_TRIGGER) + 1) < 0)
+    {
+      g_warning ("%s. Could not set memory pressure trigger. %s",
+                 __FUNCTION__,
+                 g_strerror (errno));
+      close (priv->psi_fd);
+      priv->psi_fd = -1;
+      return;
+    }
+
+  fcntl (priv->psi_fd, F_SETFD, FD_CLOEXEC);
+
+  /* The trigger is reported as an exceptional condition */
+  channel = g_io_channel_unix_new (priv->psi_fd);
+  priv->psi_watch_id = g_io_add_watch (channel,
+                                       G_IO_PRI | G_IO_ERR,
+                                       psi_event_cb,
+                                       memory_pressure);
+  g_io_channel_unref (channel);
+}
+
+static gboolean
+display_off_cb (gpointer data)
+{
+  HDMemoryPressure *memory_pressure = data;
+
+  memory_pressure->priv->display_off_id = 0;
+
+  hd_memory_pressure_trim (memory_pressure, "display off");
+
+  return FALSE;
+}
+
+static void
+display_status_changed_cb (HDDisplay        *display,
+                           HDMemoryPressure *memory_pressure)
+{
+  HDMemoryPressurePrivate *priv = memory_pressure->priv;
+
+  if (hd_display_is_on (display))
+    {
+      if (priv->display_off_id)
+        g_source_remove (priv->display_off_id);
+      priv->display_off_id = 0;
+    }
+  else if (!priv->display_off_id)
+    priv->display_off_id = g_timeout_add_seconds (DISPLAY_OFF_TRIM_DELAY,
+                                                  display_off_cb,
+                                                  memory_pressure);
+}
+
+static void
+hd_memory_pressure_init (HDMemoryPressure *memory_pressure)
+{
+  HDMemoryPressurePrivate *priv;
+
+  memory_pressure->priv = priv = HD_MEMORY_PRESSURE_GET_PRIVATE (memory_pressure);
+
+  priv->psi_fd = -1;
+  priv->last_trim = g_timer_new ();
+
+  watch_psi (memory_pressure);
+
+  priv->display = hd_display_get ();
+  g_signal_connect (priv->display, "display-status-changed",
+                    G_CALLBACK (display_status_changed_cb), memory_pressure);
+}
+
+static void
+hd_memory_pressure_dispose (GObject *object)
+{
+  HDMemoryPressurePrivate *priv = HD_MEMORY_PRESSURE (object)->priv;
+
+  if (priv->psi_watch_id)
+    g_source_remove (priv->psi_watch_id);
+  priv->psi_watch_id = 0;
+
+  if (priv->psi_fd != -1)
+    close (priv->psi_fd);
+  priv->psi_fd = -1;
+
+  if (priv->display_off_id)
+    g_source_remove (priv->display_off_id);
+  priv->display_off_id = 0;
+
+  if (priv->display)
+    {
+      g_signal_handlers_disconnect_by_func (priv->display,
+                                            display_status_changed_cb,
+                                            object);
+      priv->display = (g_object_unref (priv->display), NULL);
+    }
+
+  G_OBJECT_CLASS (hd_memory_pressure_parent_class)->dispose (object);
+}
+
+static void
+hd_memory_pressure_finalize (GObject *object)
+{
+  HDMemoryPressurePrivate *priv = HD_MEMORY_PRESSURE (object)->priv;
+
+  g_timer_destroy (priv->last_trim);
+
+  G_OBJECT_CLASS (hd_memory_pressure_parent_class)->finalize (object);
+}
+
+/* Runs after the handlers dropped their caches */
+static void
+hd_memory_pressure_real_trim (HDMemoryPressure *memory_pressure)
+{
+#ifdef HAVE_MALLOC_TRIM
+  /* Give the freed heap back to the system */
+  malloc_trim (0);
+#endif
+}
+
+static void
+hd_memory_pressure_class_init (HDMemoryPressureClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = hd_memory_pressure_dispose;
+  object_class->finalize = hd_memory_pressure_finalize;
+
+  klass->trim = hd_memory_pressure_real_trim;
+
+  memory_pressure_signals[TRIM] = g_signal_new ("trim",
+                                                HD_TYPE_MEMORY_PRESSURE,
+                                                G_SIGNAL_RUN_LAST,
+                                                G_STRUCT_OFFSET (HDMemoryPressureClass, trim),
+                                                NULL, NULL,
+                                                g_cclosure_marshal_VOID__VOID,
+                                                G_TYPE_NONE,
+                                                0);
+
+  g_type_class_add_private (klass, sizeof (HDMemoryPressurePrivate));
+}
+
+/**
+ * hd_memory_pressure_trim:
+ * @memory_pressure: a #HDMemoryPressure
+ * @reason: why memory is trimmed, for the log
+ *
+ * Emits the "trim" signal, on which the status area and menu drop what
+ * they can rebuild on next use, and returns the freed heap to the
+ * system.
+ **/
+void
+hd_memory_pressure_trim (HDMemoryPressure *memory_pressure,
+                         const gchar      *reason)
+{
+  gulong rss;
+
+  g_return_if_fail (HD_IS_MEMORY_PRESSURE (memory_pressure));
+
+  rss = hd_memory_pressure_get_rss ();
+
+  g_signal_emit (memory_pressure, memory_pressure_signals[TRIM], 0);
+
+  g_timer_start (memory_pressure->priv->last_trim);
+
+  g_message ("Trimmed memory (%s), RSS %lu kB -> %lu kB",
+             reason,
+             rss,
+             hd_memory_pressure_get_rss ());
+}
+
+/**
+ * hd_memory_pressure_get_rss:
+ *
+ * Returns: the resident set size of the process in kB, 0 if unknown
+ **/
+gulong
+hd_memory_pressure_get_rss (void)
+{
+  gchar *status, *line;
+  gulong rss = 0;
+
+  if (!g_file_get_contents ("/proc/self/status", &status, NULL, NULL))
+    return 0;
+
+  line = strstr (status, "VmRSS:");
+  if (line)
+    rss = strtoul (line + strlen ("VmRSS:"), NULL, 10);
+
+  g_free (status);
+
+  return rss;
+}
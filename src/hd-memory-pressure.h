@@ -0,0 +1,67 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef __HD_MEMORY_PRESSURE_H__
+#define __HD_MEMORY_PRESSURE_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define HD_TYPE_MEMORY_PRESSURE            (hd_memory_pressure_get_type ())
+#define HD_MEMORY_PRESSURE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), HD_TYPE_MEMORY_PRESSURE, HDMemoryPressure))
+#define HD_MEMORY_PRESSURE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), HD_TYPE_MEMORY_PRESSURE, HDMemoryPressureClass))
+#define HD_IS_MEMORY_PRESSURE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), HD_TYPE_MEMORY_PRESSURE))
+#define HD_IS_MEMORY_PRESSURE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), HD_TYPE_MEMORY_PRESSURE))
+#define HD_MEMORY_PRESSURE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), HD_TYPE_MEMORY_PRESSURE, HDMemoryPressureClass))
+
+typedef struct _HDMemoryPressure        HDMemoryPressure;
+typedef struct _HDMemoryPressureClass   HDMemoryPressureClass;
+typedef struct _HDMemoryPressurePrivate HDMemoryPressurePrivate;
+
+struct _HDMemoryPressure
+{
+  GObject parent;
+
+  HDMemoryPressurePrivate *priv;
+};
+
+struct _HDMemoryPressureClass
+{
+  GObjectClass parent;
+
+  /* signals */
+  void (*trim) (HDMemoryPressure *memory_pressure);
+};
+
+GType             hd_memory_pressure_get_type (void);
+
+HDMemoryPressure *hd_memory_pressure_get      (void);
+
+void              hd_memory_pressure_trim     (HDMemoryPressure *memory_pressure,
+                                               const gchar      *reason);
+
+gulong            hd_memory_pressure_get_rss  (void);
+
+G_END_DECLS
+
+#endif
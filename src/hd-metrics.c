@@ -0,0 +1,292 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hd-metrics.h"
+#include "hd-signal-dump.h"
+#include "hd-time.h"
+
+/* name -> HDMetricsHistogram, names are static strings */
+static GHashTable *histograms = NULL;
+
+/* name -> guint count, names are static strings */
+static GHashTable *counters = NULL;
+
+/* Upper bounds of the buckets in microseconds, the last one takes the
+ * rest */
+static const guint64 bucket_bounds[HD_METRICS_N_BUCKETS] =
+{
+  50, 100, 250, 500,
+  1000, 2500, 5000, 10000,
+  25000, 50000, 100000, 250000,
+  500000, 1000000, 2500000, G_MAXUINT64
+};
+
+/* Signal whose dump is repeated every HD_METRICS_INTERVAL_ENV seconds */
+static int dump_signum = 0;
+
+/**
+ * hd_metrics_get_histogram:
+ * @name: name of the histogram, a static string
+ *
+ * Returns: the histogram @name, created empty on first use. Hot paths
+ * use HD_METRICS_END() which looks it up only once.
+ **/
+HDMetricsHistogram *
+hd_metrics_get_histogram (const gchar *name)
+{
+  HDMetricsHistogram *histogram;
+
+  if (!histograms)
+    histograms = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                        NULL,
+                                        (GDestroyNotify) g_free);
+
+  histogram = g_hash_table_lookup (histograms, name);
+  if (!histogram)
+    {
+      histogram = g_new0 (HDMetricsHistogram, 1);
+      g_hash_table_insert (histograms, (gpointer) name, histogram);
+    }
+
+  return histogram;
+}
+
+/**
+ * hd_metrics_get_counter:
+ * @name: name of the counter, a static string
+ *
+ * Returns: the counter @name, created as 0 on first use. Hot paths use
+ * HD_METRICS_COUNT() which looks it up only once.
+ **/
+guint *
+hd_metrics_get_counter (const gchar *name)
+{
+  guint *counter;
+
+  if (!counters)
+    counters = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                      NULL,
+                                      (GDestroyNotify) g_free);
+
+  counter = g_hash_table_lookup (counters, name);
+  if (!counter)
+    {
+      counter = g_new0 (guint, 1);
+      g_hash_table_insert (counters, (gpointer) name, counter);
+    }
+
+  return counter;
+}
+
+/**
+ * hd_metrics_begin:
+ *
+ * Returns: the start of an operation, to be passed to hd_metrics_end()
+ **/
+gint64
+hd_metrics_begin (void)
+{
+  return hd_time_get_monotonic_us ();
+}
+
+/**
+ * hd_metrics_end:
+ * @histogram: a #HDMetricsHistogram
+ * @start: the value returned by hd_metrics_begin()
+ *
+ * Adds the time since @start to @histogram.
+ **/
+void
+hd_metrics_end (HDMetricsHistogram *histogram,
+                gint64              start)
+{
+  gint64 now = hd_metrics_begin ();
+
+  hd_metrics_observe (histogram, now > start ? now - start : 0);
+}
+
+void
+hd_metrics_observe (HDMetricsHistogram *histogram,
+                    guint64             duration_us)
+{
+  guint bucket;
+
+  for (bucket = 0; duration_us > bucket_bounds[bucket]; bucket++);
+
+  histogram->count++;
+  histogram->sum_us += duration_us;
+  histogram->max_us = MAX (histogram->max_us, duration_us);
+  histogram->buckets[bucket]++;
+}
+
+guint64
+hd_metrics_get_bucket_bound (guint bucket)
+{
+  g_return_val_if_fail (bucket < HD_METRICS_N_BUCKETS, G_MAXUINT64);
+
+  return bucket_bounds[bucket];
+}
+
+/**
+ * hd_metrics_percentile:
+ * @histogram: a #HDMetricsHistogram
+ * @percentile: the percentile, from 0 to 100
+ *
+ * Returns: the upper bound of the bucket holding @percentile, at most
+ * the largest latency seen, in microseconds
+ **/
+guint64
+hd_metrics_percentile (const HDMetricsHistogram *histogram,
+                       gdouble                   percentile)
+{
+  guint rank, seen = 0;
+  guint bucket;
+
+  if (!histogram->count)
+    return 0;
+
+  /* Nearest rank */
+  rank = (guint) (percentile / 100.0 * histogram->count + 0.5);
+  rank = CLAMP (rank, 1, histogram->count);
+
+  for (bucket = 0; bucket < HD_METRICS_N_BUCKETS - 1; bucket++)
+    {
+      seen += histogram->buckets[bucket];
+      if (seen >= rank)
+        break;
+    }
+
+  return MIN (bucket_bounds[bucket], histogram->max_us);
+}
+
+static gint
+compare_names (gconstpointer a,
+               gconstpointer b)
+{
+  return strcmp (a, b);
+}
+
+static void
+dump_histogram (const gchar              *name,
+                const HDMetricsHistogram *histogram,
+                FILE                     *file)
+{
+  guint bucket;
+
+  fprintf (file, "%-24s %8u %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+           name,
+           histogram->count,
+           histogram->count ? histogram->sum_us / 1000.0 / histogram->count : 0.0,
+           hd_metrics_percentile (histogram, 50) / 1000.0,
+           hd_metrics_percentile (histogram, 90) / 1000.0,
+           hd_metrics_percentile (histogram, 99) / 1000.0,
+           histogram->max_us / 1000.0);
+
+  /* Non empty buckets as upper bound in ms:count */
+  fprintf (file, "  buckets");
+  for (bucket = 0; bucket < HD_METRICS_N_BUCKETS - 1; bucket++)
+    if (histogram->buckets[bucket])
+      fprintf (file, " %g:%u",
+               bucket_bounds[bucket] / 1000.0,
+               histogram->buckets[bucket]);
+  if (histogram->buckets[bucket])
+    fprintf (file, " inf:%u", histogram->buckets[bucket]);
+  fprintf (file, "\n");
+}
+
+/**
+ * hd_metrics_dump:
+ * @file: the file to write to
+ *
+ * Writes all histograms, with their percentiles and non empty buckets,
+ * and all counters sorted by name.
+ **/
+void
+hd_metrics_dump (FILE *file)
+{
+  GList *names, *n;
+
+  fprintf (file, "%-24s %8s %10s %10s %10s %10s %10s\n",
+           "histogram", "count", "mean_ms", "p50_ms", "p90_ms", "p99_ms", "max_ms");
+
+  if (histograms)
+    {
+      names = g_list_sort (g_hash_table_get_keys (histograms), compare_names);
+      for (n = names; n; n = n->next)
+        dump_histogram (n->data, g_hash_table_lookup (histograms, n->data), file);
+      g_list_free (names);
+    }
+
+  fprintf (file, "\n%-24s %8s\n", "counter", "count");
+
+  if (counters)
+    {
+      names = g_list_sort (g_hash_table_get_keys (counters), compare_names);
+      for (n = names; n; n = n->next)
+        fprintf (file, "%-24s %8u\n",
+                 (const gchar *) n->data,
+                 *(guint *) g_hash_table_lookup (counters, n->data));
+      g_list_free (names);
+    }
+}
+
+static gboolean
+dump_timeout_cb (gpointer data)
+{
+  hd_signal_dump_write (dump_signum);
+
+  return TRUE;
+}
+
+/**
+ * hd_metrics_dump_on_signal:
+ * @signum: the signal which requests a dump
+ * @filename: the file the metrics are written to
+ *
+ * Writes the metrics to @filename from the main loop whenever the
+ * process receives @signum, and every %HD_METRICS_INTERVAL_ENV seconds
+ * if that is set. Other statistics can be added to the same file with
+ * hd_signal_dump_add().
+ **/
+void
+hd_metrics_dump_on_signal (int          signum,
+                           const gchar *filename)
+{
+  const gchar *interval;
+
+  g_return_if_fail (dump_signum == 0);
+
+  dump_signum = signum;
+  hd_signal_dump_add (signum, filename, (HDSignalDumpFunc) hd_metrics_dump, NULL);
+
+  /* Seconds timeouts are aligned with other wakeups of the process */
+  interval = g_getenv (HD_METRICS_INTERVAL_ENV);
+  if (interval && atoi (interval) > 0)
+    g_timeout_add_seconds (atoi (interval), dump_timeout_cb, NULL);
+}
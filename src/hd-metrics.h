@@ -0,0 +1,95 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef __HD_METRICS_H__
+#define __HD_METRICS_H__
+
+#include <glib.h>
+
+#include <stdio.h>
+
+G_BEGIN_DECLS
+
+/* Seconds between dumps, in addition to the signal */
+#define HD_METRICS_INTERVAL_ENV "HD_STATUS_MENU_METRICS_INTERVAL"
+
+#define HD_METRICS_N_BUCKETS 16
+
+typedef struct _HDMetricsHistogram HDMetricsHistogram;
+
+/* Latencies of a named hot path in fixed buckets, see
+ * hd_metrics_get_bucket_bound() */
+struct _HDMetricsHistogram
+{
+  guint   count;
+  guint64 sum_us;
+  guint64 max_us;
+
+  guint   buckets[HD_METRICS_N_BUCKETS];
+};
+
+/* The histogram or counter of @name, a static string, is looked up
+ * once per call site */
+#define HD_METRICS_END(name, start)                                    \
+  G_STMT_START {                                                       \
+    static HDMetricsHistogram *hd_metrics_histogram = NULL;            \
+    if (G_UNLIKELY (!hd_metrics_histogram))                            \
+      hd_metrics_histogram = hd_metrics_get_histogram (name);          \
+    hd_metrics_end (hd_metrics_histogram, (start));                    \
+  } G_STMT_END
+
+#define HD_METRICS_OBSERVE(name, duration_us)                          \
+  G_STMT_START {                                                       \
+    static HDMetricsHistogram *hd_metrics_histogram = NULL;            \
+    if (G_UNLIKELY (!hd_metrics_histogram))                            \
+      hd_metrics_histogram = hd_metrics_get_histogram (name);          \
+    hd_metrics_observe (hd_metrics_histogram, (duration_us));          \
+  } G_STMT_END
+
+#define HD_METRICS_COUNT(name)                                         \
+  G_STMT_START {                                                       \
+    static guint *hd_metrics_counter = NULL;                           \
+    if (G_UNLIKELY (!hd_metrics_counter))                              \
+      hd_metrics_counter = hd_metrics_get_counter (name);              \
+    (*hd_metrics_counter)++;                                           \
+  } G_STMT_END
+
+HDMetricsHistogram *hd_metrics_get_histogram    (const gchar        *name);
+guint              *hd_metrics_get_counter      (const gchar        *name);
+
+gint64              hd_metrics_begin            (void);
+void                hd_metrics_end              (HDMetricsHistogram *histogram,
+                                                 gint64              start);
+void                hd_metrics_observe          (HDMetricsHistogram *histogram,
+                                                 guint64             duration_us);
+
+guint64             hd_metrics_get_bucket_bound (guint               bucket);
+guint64             hd_metrics_percentile       (const HDMetricsHistogram *histogram,
+                                                 gdouble             percentile);
+
+void                hd_metrics_dump             (FILE               *file);
+void                hd_metrics_dump_on_signal   (int                 signum,
+                                                 const gchar        *filename);
+
+G_END_DECLS
+
+#endif
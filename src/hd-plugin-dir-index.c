@@ -0,0 +1,430 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hd-plugin-dir-index.h"
+
+#define HD_PLUGIN_DIR_INDEX_GET_PRIVATE(object) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((object), HD_TYPE_PLUGIN_DIR_INDEX, HDPluginDirIndexPrivate))
+
+/* Wait until the directory is quiet for this long before reporting
+ * changes, but do not delay a burst (package upgrade) for more than
+ * HD_PLUGIN_DIR_INDEX_MAX_DELAY */
+#define HD_PLUGIN_DIR_INDEX_QUIET_PERIOD 250
+#define HD_PLUGIN_DIR_INDEX_MAX_DELAY    2000
+
+#define HD_PLUGIN_DIR_INDEX_EVENTS (IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | \
+                                    IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB)
+
+#define DESKTOP_FILE_SUFFIX ".desktop"
+
+struct _HDPluginDirIndexPrivate
+{
+  gchar *path;
+
+  int inotify_fd;
+  GIOChannel *channel;
+  guint watch_id;
+
+  /* file name -> HDPluginDirIndexEntry */
+  GHashTable *entries;
+
+  /* file names touched since the last flush */
+  GHashTable *dirty;
+  gboolean rescan : 1;
+
+  guint flush_id;
+  GTimeVal burst_start;
+  GTimeVal last_event;
+};
+
+typedef struct _HDPluginDirIndexEntry HDPluginDirIndexEntry;
+struct _HDPluginDirIndexEntry
+{
+  ino_t  ino;
+  off_t  size;
+  time_t mtime;
+  time_t ctime;
+};
+
+enum
+{
+  CHANGED,
+
+  LAST_SIGNAL
+};
+
+static guint index_signals[LAST_SIGNAL] = { 0, };
+
+static void hd_plugin_dir_index_dispose  (GObject *object);
+static void hd_plugin_dir_index_finalize (GObject *object);
+
+G_DEFINE_TYPE (HDPluginDirIndex, hd_plugin_dir_index, G_TYPE_OBJECT);
+
+static void
+hd_plugin_dir_index_class_init (HDPluginDirIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = hd_plugin_dir_index_dispose;
+  object_class->finalize = hd_plugin_dir_index_finalize;
+
+  index_signals[CHANGED] = g_signal_new ("changed",
+                                         HD_TYPE_PLUGIN_DIR_INDEX,
+                                         0, 0,
+                                         NULL, NULL,
+                                         g_cclosure_marshal_VOID__POINTER,
+                                         G_TYPE_NONE,
+                                         1, G_TYPE_POINTER);
+
+  g_type_class_add_private (klass, sizeof (HDPluginDirIndexPrivate));
+}
+
+static void
+entry_free (HDPluginDirIndexEntry *entry)
+{
+  g_slice_free (HDPluginDirIndexEntry, entry);
+}
+
+static void
+hd_plugin_dir_index_init (HDPluginDirIndex *index)
+{
+  HDPluginDirIndexPrivate *priv;
+
+  index->priv = priv = HD_PLUGIN_DIR_INDEX_GET_PRIVATE (index);
+
+  priv->inotify_fd = -1;
+  priv->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                         (GDestroyNotify) g_free,
+                                         (GDestroyNotify) entry_free);
+  priv->dirty = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                       (GDestroyNotify) g_free,
+                                       NULL);
+}
+
+static gboolean
+is_desktop_file (const gchar *name)
+{
+  return g_str_has_suffix (name, DESKTOP_FILE_SUFFIX);
+}
+
+/* Returns TRUE if @name exists, filling @entry */
+static gboolean
+stat_entry (HDPluginDirIndex      *index,
+            const gchar           *name,
+            HDPluginDirIndexEntry *entry)
+{
+  HDPluginDirIndexPrivate *priv = index->priv;
+  gchar *filename;
+  struct stat st;
+  int result;
+
+  filename = g_build_filename (priv->path, name, NULL);
+  result = stat (filename, &st);
+  g_free (filename);
+
+  if (result != 0 || !S_ISREG (st.st_mode))
+    return FALSE;
+
+  entry->ino = st.st_ino;
+  entry->size = st.st_size;
+  entry->mtime = st.st_mtime;
+  entry->ctime = st.st_ctime;
+
+  return TRUE;
+}
+
+/* Mark all known and present desktop files dirty, used initially and if
+ * inotify events were lost */
+static void
+mark_all_dirty (HDPluginDirIndex *index)
+{
+  HDPluginDirIndexPrivate *priv = index->priv;
+  GHashTableIter iter;
+  gpointer key;
+  GDir *dir;
+
+  g_hash_table_iter_init (&iter, priv->entries);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    g_hash_table_replace (priv->dirty, g_strdup (key), NULL);
+
+  dir = g_dir_open (priv->path, 0, NULL);
+  if (dir)
+    {
+      const gchar *name;
+
+      while ((name = g_dir_read_name (dir)))
+        if (is_desktop_file (name))
+          g_hash_table_replace (priv->dirty, g_strdup (name), NULL);
+
+      g_dir_close (dir);
+    }
+}
+
+/* Update the index for the dirty file names only and report the difference */
+static void
+flush_changes (HDPluginDirIndex *index,
+               gboolean          emit)
+{
+  HDPluginDirIndexPrivate *priv = index->priv;
+  HDPluginDirIndexChanges changes = { NULL, NULL, NULL };
+  GHashTableIter iter;
+  gpointer key;
+
+  if (priv->rescan)
+    {
+      priv->rescan = FALSE;
+      mark_all_dirty (index);
+    }
+
+  g_hash_table_iter_init (&iter, priv->dirty);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      const gchar *name = key;
+      HDPluginDirIndexEntry current, *entry;
+
+      entry = g_hash_table_lookup (priv->entries, name);
+
+      if (stat_entry (index, name, &current))
+        {
+          if (!entry)
+            {
+              entry = g_slice_new (HDPluginDirIndexEntry);
+              *entry = current;
+              g_hash_table_insert (priv->entries, g_strdup (name), entry);
+              changes.added = g_slist_prepend (changes.added, (gpointer) name);
+            }
+          else if (entry->ino != current.ino ||
+                   entry->size != current.size ||
+                   entry->mtime != current.mtime ||
+                   entry->ctime != current.ctime)
+            {
+              *entry = current;
+              changes.changed = g_slist_prepend (changes.changed, (gpointer) name);
+            }
+        }
+      else if (entry)
+        {
+          g_hash_table_remove (priv->entries, name);
+          changes.removed = g_slist_prepend (changes.removed, (gpointer) name);
+        }
+    }
+
+  if (emit && (changes.added || changes.changed || changes.removed))
+    g_signal_emit (index, index_signals[CHANGED], 0, &changes);
+
+  g_slist_free (changes.added);
+  g_slist_free (changes.changed);
+  g_slist_free (changes.removed);
+
+  /* The names in the lists are owned by the dirty table */
+  g_hash_table_remove_all (priv->dirty);
+}
+
+static glong
+elapsed_ms (const GTimeVal *since,
+            const GTimeVal *now)
+{
+  return (now->tv_sec - since->tv_sec) * 1000 +
+         (now->tv_usec - since->tv_usec) / 1000;
+}
+
+static gboolean
+flush_timeout_cb (gpointer data)
+{
+  HDPluginDirIndex *index = data;
+  HDPluginDirIndexPrivate *priv = index->priv;
+  GTimeVal now;
+
+  g_get_current_time (&now);
+
+  /* Still busy, wait for the burst to end */
+  if (elapsed_ms (&priv->last_event, &now) < HD_PLUGIN_DIR_INDEX_QUIET_PERIOD &&
+      elapsed_ms (&priv->burst_start, &now) < HD_PLUGIN_DIR_INDEX_MAX_DELAY)
+    return TRUE;
+
+  priv->flush_id = 0;
+
+  flush_changes (index, TRUE);
+
+  return FALSE;
+}
+
+static gboolean
+inotify_io_cb (GIOChannel   *channel,
+               GIOCondition  condition,
+               gpointer      data)
+{
+  HDPluginDirIndex *index = data;
+  HDPluginDirIndexPrivate *priv = index->priv;
+  gchar buffer[4096] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+  ssize_t len;
+
+  if (condition & (G_IO_ERR | G_IO_HUP | G_IO_NVAL))
+    {
+      priv->watch_id = 0;
+      return FALSE;
+    }
+
+  while ((len = read (priv->inotify_fd, buffer, sizeof (buffer))) > 0)
+    {
+      gchar *p;
+
+      for (p = buffer; p < buffer + len; )
+        {
+          struct inotify_event *event = (struct inotify_event *) p;
+
+          if (event->mask & IN_Q_OVERFLOW)
+            priv->rescan = TRUE;
+          else if (event->len && is_desktop_file (event->name))
+            g_hash_table_replace (priv->dirty, g_strdup (event->name), NULL);
+
+          p += sizeof (struct inotify_event) + event->len;
+        }
+    }
+
+  if (len < 0 && errno != EAGAIN && errno != EINTR)
+    g_warning ("%s. Could not read inotify events. %s",
+               __FUNCTION__,
+               g_strerror (errno));
+
+  if (!priv->rescan && g_hash_table_size (priv->dirty) == 0)
+    return TRUE;
+
+  g_get_current_time (&priv->last_event);
+
+  if (!priv->flush_id)
+    {
+      priv->burst_start = priv->last_event;
+      priv->flush_id = g_timeout_add (HD_PLUGIN_DIR_INDEX_QUIET_PERIOD,
+                                      flush_timeout_cb,
+                                      index);
+    }
+
+  return TRUE;
+}
+
+static void
+initialize_inotify (HDPluginDirIndex *index)
+{
+  HDPluginDirIndexPrivate *priv = index->priv;
+
+  priv->inotify_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+  if (priv->inotify_fd < 0)
+    {
+      g_warning ("%s. Could not initialize inotify. %s",
+                 __FUNCTION__,
+                 g_strerror (errno));
+      return;
+    }
+
+  if (inotify_add_watch (priv->inotify_fd,
+                         priv->path,
+                         HD_PLUGIN_DIR_INDEX_EVENTS) < 0)
+    {
+      g_warning ("%s. Could not watch %s. %s",
+                 __FUNCTION__,
+                 priv->path,
+                 g_strerror (errno));
+      close (priv->inotify_fd);
+      priv->inotify_fd = -1;
+      return;
+    }
+
+  priv->channel = g_io_channel_unix_new (priv->inotify_fd);
+  priv->watch_id = g_io_add_watch (priv->channel,
+                                   G_IO_IN | G_IO_ERR | G_IO_HUP,
+                                   inotify_io_cb,
+                                   index);
+}
+
+static void
+hd_plugin_dir_index_dispose (GObject *object)
+{
+  HDPluginDirIndexPrivate *priv = HD_PLUGIN_DIR_INDEX (object)->priv;
+
+  if (priv->flush_id)
+    priv->flush_id = (g_source_remove (priv->flush_id), 0);
+
+  if (priv->watch_id)
+    priv->watch_id = (g_source_remove (priv->watch_id), 0);
+
+  if (priv->channel)
+    priv->channel = (g_io_channel_unref (priv->channel), NULL);
+
+  if (priv->inotify_fd >= 0)
+    priv->inotify_fd = (close (priv->inotify_fd), -1);
+
+  G_OBJECT_CLASS (hd_plugin_dir_index_parent_class)->dispose (object);
+}
+
+static void
+hd_plugin_dir_index_finalize (GObject *object)
+{
+  HDPluginDirIndexPrivate *priv = HD_PLUGIN_DIR_INDEX (object)->priv;
+
+  g_free (priv->path);
+  g_hash_table_destroy (priv->entries);
+  g_hash_table_destroy (priv->dirty);
+
+  G_OBJECT_CLASS (hd_plugin_dir_index_parent_class)->finalize (object);
+}
+
+/**
+ * hd_plugin_dir_index_new:
+ * @path: the plugin directory
+ *
+ * Creates an index of the desktop files in @path which is kept up to date
+ * with inotify. Bursts of changes are debounced and reported with a single
+ * ::changed signal listing exactly the added, changed and removed desktop
+ * files; only the touched files are examined.
+ *
+ * Returns: a new #HDPluginDirIndex
+ **/
+HDPluginDirIndex *
+hd_plugin_dir_index_new (const gchar *path)
+{
+  HDPluginDirIndex *index;
+
+  g_return_val_if_fail (path != NULL, NULL);
+
+  index = g_object_new (HD_TYPE_PLUGIN_DIR_INDEX, NULL);
+  index->priv->path = g_strdup (path);
+
+  /* Start watching before the initial scan so no change is lost */
+  initialize_inotify (index);
+
+  index->priv->rescan = TRUE;
+  flush_changes (index, FALSE);
+
+  return index;
+}
@@ -0,0 +1,69 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_PLUGIN_DIR_INDEX_H__
+#define __HD_PLUGIN_DIR_INDEX_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define HD_TYPE_PLUGIN_DIR_INDEX            (hd_plugin_dir_index_get_type ())
+#define HD_PLUGIN_DIR_INDEX(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), HD_TYPE_PLUGIN_DIR_INDEX, HDPluginDirIndex))
+#define HD_PLUGIN_DIR_INDEX_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), HD_TYPE_PLUGIN_DIR_INDEX, HDPluginDirIndexClass))
+#define HD_IS_PLUGIN_DIR_INDEX(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), HD_TYPE_PLUGIN_DIR_INDEX))
+#define HD_IS_PLUGIN_DIR_INDEX_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), HD_TYPE_PLUGIN_DIR_INDEX))
+#define HD_PLUGIN_DIR_INDEX_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), HD_TYPE_PLUGIN_DIR_INDEX, HDPluginDirIndexClass))
+
+typedef struct _HDPluginDirIndex        HDPluginDirIndex;
+typedef struct _HDPluginDirIndexClass   HDPluginDirIndexClass;
+typedef struct _HDPluginDirIndexPrivate HDPluginDirIndexPrivate;
+
+typedef struct _HDPluginDirIndexChanges HDPluginDirIndexChanges;
+
+/* Passed to the ::changed signal, lists of desktop file names
+ * (which are also the plugin ids) */
+struct _HDPluginDirIndexChanges
+{
+  GSList *added;
+  GSList *changed;
+  GSList *removed;
+};
+
+struct _HDPluginDirIndex
+{
+  GObject parent;
+
+  HDPluginDirIndexPrivate *priv;
+};
+
+struct _HDPluginDirIndexClass
+{
+  GObjectClass parent;
+};
+
+GType             hd_plugin_dir_index_get_type (void);
+
+HDPluginDirIndex *hd_plugin_dir_index_new      (const gchar *path);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,376 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <libhildondesktop/libhildondesktop.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "hd-flight-recorder.h"
+#include "hd-plugin-stats.h"
+#include "hd-signal-dump.h"
+#include "hd-time.h"
+
+/* plugin id -> HDPluginStats, entries are kept after the plugin is
+ * removed so the totals survive reloads */
+static GHashTable *stats_table = NULL;
+
+/* plugin object -> HDPluginStats of its id, looked up by pointer only
+ * so any callback data can be checked */
+static GHashTable *plugin_stats = NULL;
+
+/* Usage is compared with the quota over this many seconds */
+#define QUOTA_WINDOW 10
+
+/* Dispatches which take more CPU time go to the flight recorder */
+#define FLIGHT_RECORDER_MIN_DISPATCH_US 1000
+
+/* Demoted plugin ids, one per line, NULL if they are not kept */
+static gchar *demoted_filename = NULL;
+
+static HDPluginStats *
+get_stats (const gchar *plugin_id)
+{
+  HDPluginStats *stats;
+
+  if (!stats_table)
+    stats_table = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                         (GDestroyNotify) g_free,
+                                         NULL);
+
+  stats = g_hash_table_lookup (stats_table, plugin_id);
+  if (!stats)
+    {
+      stats = g_new0 (HDPluginStats, 1);
+      stats->plugin_id = g_strdup (plugin_id);
+      g_hash_table_insert (stats_table, (gpointer) stats->plugin_id, stats);
+    }
+
+  return stats;
+}
+
+/**
+ * hd_plugin_stats_register:
+ * @plugin: a loaded plugin
+ *
+ * Associates @plugin with the statistics of its plugin id, so work done
+ * on behalf of the plugin object can be attributed with
+ * hd_plugin_stats_lookup().
+ **/
+void
+hd_plugin_stats_register (GObject *plugin)
+{
+  gchar *plugin_id;
+
+  if (!HD_IS_PLUGIN_ITEM (plugin))
+    return;
+
+  if (!plugin_stats)
+    plugin_stats = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  plugin_id = hd_plugin_item_get_plugin_id (HD_PLUGIN_ITEM (plugin));
+  g_hash_table_insert (plugin_stats, plugin, get_stats (plugin_id));
+  g_free (plugin_id);
+}
+
+void
+hd_plugin_stats_unregister (GObject *plugin)
+{
+  if (plugin_stats)
+    g_hash_table_remove (plugin_stats, plugin);
+}
+
+/**
+ * hd_plugin_stats_lookup:
+ * @object: any object or pointer
+ *
+ * Returns: the statistics of @object if it is a registered plugin,
+ * %NULL otherwise
+ **/
+HDPluginStats *
+hd_plugin_stats_lookup (gpointer object)
+{
+  if (!plugin_stats || !object)
+    return NULL;
+
+  return g_hash_table_lookup (plugin_stats, object);
+}
+
+/* Appended, so a restarted process loads the plugin last again */
+static void
+save_demoted (HDPluginStats *stats)
+{
+  FILE *file;
+
+  if (!demoted_filename)
+    return;
+
+  file = fopen (demoted_filename, "a");
+  if (!file)
+    {
+      g_warning ("%s. Could not open %s. %s",
+                 __FUNCTION__,
+                 demoted_filename,
+                 g_strerror (errno));
+      return;
+    }
+
+  fprintf (file, "%s\n", stats->plugin_id);
+  fclose (file);
+}
+
+/* Checked when usage is recorded, so quotas cost no wakeups */
+static void
+check_quota (HDPluginStats *stats)
+{
+  gint64 now, elapsed;
+  gdouble cpu_rate, icon_rate;
+
+  if (stats->demoted || (!stats->max_cpu && !stats->max_icon_rate))
+    return;
+
+  now = hd_time_get_monotonic_ms ();
+  if (!stats->window_start)
+    stats->window_start = now;
+
+  elapsed = now - stats->window_start;
+  if (elapsed < QUOTA_WINDOW * 1000)
+    return;
+
+  cpu_rate = stats->window_cpu_us / (gdouble) elapsed;
+  icon_rate = stats->window_icon_updates * 1000.0 / elapsed;
+
+  stats->window_start = now;
+  stats->window_cpu_us = 0;
+  stats->window_icon_updates = 0;
+
+  if ((stats->max_cpu && cpu_rate > stats->max_cpu) ||
+      (stats->max_icon_rate && icon_rate > stats->max_icon_rate))
+    {
+      stats->demoted = TRUE;
+
+      g_warning ("Plugin %s exceeded its quota (%.1f CPU ms/s, %.1f icon updates/s; "
+                 "limits %u, %u), its updates are throttled from now on",
+                 stats->plugin_id,
+                 cpu_rate, icon_rate,
+                 stats->max_cpu, stats->max_icon_rate);
+
+      save_demoted (stats);
+    }
+}
+
+/**
+ * hd_plugin_stats_load_demoted:
+ * @filename: the file which keeps the demoted plugin ids
+ *
+ * Demotes the plugin ids which were demoted by an earlier process, and
+ * appends plugins demoted from now on to @filename. Call before the
+ * plugins are loaded, so the demoted ones are loaded last.
+ **/
+void
+hd_plugin_stats_load_demoted (const gchar *filename)
+{
+  gchar *contents, **lines;
+  GError *error = NULL;
+  guint i;
+
+  g_free (demoted_filename);
+  demoted_filename = g_strdup (filename);
+
+  if (!g_file_get_contents (filename, &contents, NULL, &error))
+    {
+      if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_warning ("%s. Could not read %s. %s",
+                   __FUNCTION__,
+                   filename,
+                   error->message);
+      g_error_free (error);
+      return;
+    }
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i]; i++)
+    if (lines[i][0])
+      get_stats (lines[i])->demoted = TRUE;
+
+  g_strfreev (lines);
+  g_free (contents);
+}
+
+/**
+ * hd_plugin_stats_set_quota:
+ * @plugin_id: the plugin id
+ * @max_cpu: main loop CPU ms per second, 0 for unlimited
+ * @max_icon_rate: icon updates per second, 0 for unlimited
+ *
+ * Sets the budget of @plugin_id. A plugin which uses more over a ten
+ * second window is demoted: its status area updates are throttled and
+ * it is loaded last. Demotion lasts for the lifetime of the process,
+ * and for later processes if hd_plugin_stats_load_demoted() was
+ * called.
+ **/
+void
+hd_plugin_stats_set_quota (const gchar *plugin_id,
+                           guint        max_cpu,
+                           guint        max_icon_rate)
+{
+  HDPluginStats *stats = get_stats (plugin_id);
+
+  stats->max_cpu = max_cpu;
+  stats->max_icon_rate = max_icon_rate;
+}
+
+gboolean
+hd_plugin_stats_is_demoted (const gchar *plugin_id)
+{
+  HDPluginStats *stats;
+
+  if (!stats_table)
+    return FALSE;
+
+  stats = g_hash_table_lookup (stats_table, plugin_id);
+
+  return stats && stats->demoted;
+}
+
+static gint64
+get_thread_cpu_time_us (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts);
+
+  return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+/**
+ * hd_plugin_stats_begin:
+ * @stats: the statistics of the plugin or %NULL
+ *
+ * Returns: the start of a dispatch, to be passed to
+ * hd_plugin_stats_end(). The clock is not read without @stats.
+ **/
+gint64
+hd_plugin_stats_begin (HDPluginStats *stats)
+{
+  return stats ? get_thread_cpu_time_us () : 0;
+}
+
+/**
+ * hd_plugin_stats_end:
+ * @stats: the statistics of the plugin or %NULL
+ * @start: the value returned by hd_plugin_stats_begin()
+ *
+ * Adds one dispatch and the CPU time used since @start to @stats.
+ **/
+void
+hd_plugin_stats_end (HDPluginStats *stats,
+                     gint64         start)
+{
+  gint64 now;
+
+  if (!stats)
+    return;
+
+  now = get_thread_cpu_time_us ();
+
+  stats->dispatches++;
+  if (now > start)
+    {
+      stats->cpu_us += now - start;
+      stats->window_cpu_us += now - start;
+
+      if (now - start >= FLIGHT_RECORDER_MIN_DISPATCH_US)
+        hd_flight_recorder_record (HD_FLIGHT_EVENT_PLUGIN_DISPATCH,
+                                   now - start, 0, stats->plugin_id);
+    }
+
+  check_quota (stats);
+}
+
+/**
+ * hd_plugin_stats_icon_update:
+ * @stats: the statistics of the plugin or %NULL
+ *
+ * Counts a status area icon change of the plugin.
+ **/
+void
+hd_plugin_stats_icon_update (HDPluginStats *stats)
+{
+  if (!stats)
+    return;
+
+  stats->icon_updates++;
+  stats->window_icon_updates++;
+
+  check_quota (stats);
+}
+
+void
+hd_plugin_stats_dump (FILE *file)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+
+  /* Sources the plugins add themselves and their status menu widgets
+   * are not covered */
+  fprintf (file, "# cpu_ms and dispatches: status area callbacks and timer service subscriptions\n");
+  fprintf (file, "%-48s %10s %10s %12s %8s %8s\n",
+           "plugin", "cpu_ms", "dispatches", "icon_updates", "resizes", "demoted");
+
+  if (!stats_table)
+    return;
+
+  g_hash_table_iter_init (&iter, stats_table);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      HDPluginStats *stats = value;
+
+      fprintf (file, "%-48s %10.1f %10u %12u %8u %8s\n",
+               (const gchar *) key,
+               stats->cpu_us / 1000.0,
+               stats->dispatches,
+               stats->icon_updates,
+               stats->resizes,
+               stats->demoted ? "yes" : "no");
+    }
+}
+
+/**
+ * hd_plugin_stats_dump_on_signal:
+ * @signum: the signal which requests a dump
+ * @filename: the file the table is written to
+ *
+ * Writes the statistics table to @filename from the main loop whenever
+ * the process receives @signum.
+ **/
+void
+hd_plugin_stats_dump_on_signal (int          signum,
+                                const gchar *filename)
+{
+  hd_signal_dump_add (signum, filename, (HDSignalDumpFunc) hd_plugin_stats_dump, NULL);
+}
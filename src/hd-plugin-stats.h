@@ -0,0 +1,82 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_PLUGIN_STATS_H__
+#define __HD_PLUGIN_STATS_H__
+
+#include <glib-object.h>
+
+#include <stdio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _HDPluginStats HDPluginStats;
+
+/* Main loop work attributed to a plugin id: the status area callbacks
+ * and the timer service subscriptions of the plugin. Sources the plugin
+ * adds itself and its status menu widgets are not covered, except for
+ * the menu resizes */
+struct _HDPluginStats
+{
+  const gchar *plugin_id;
+
+  guint64 cpu_us;
+  guint   dispatches;
+  guint   icon_updates;
+  guint   resizes;
+
+  /* quota, 0 is unlimited */
+  guint   max_cpu;         /* main loop CPU ms per second */
+  guint   max_icon_rate;   /* icon updates per second */
+
+  /* usage in the current quota window */
+  gint64  window_start;
+  guint64 window_cpu_us;
+  guint   window_icon_updates;
+
+  /* exceeded its quota, updates are throttled */
+  guint   demoted : 1;
+};
+
+void           hd_plugin_stats_register       (GObject       *plugin);
+void           hd_plugin_stats_unregister     (GObject       *plugin);
+
+HDPluginStats *hd_plugin_stats_lookup         (gpointer       object);
+
+void           hd_plugin_stats_set_quota      (const gchar   *plugin_id,
+                                               guint          max_cpu,
+                                               guint          max_icon_rate);
+gboolean       hd_plugin_stats_is_demoted     (const gchar   *plugin_id);
+void           hd_plugin_stats_load_demoted   (const gchar   *filename);
+
+gint64         hd_plugin_stats_begin          (HDPluginStats *stats);
+void           hd_plugin_stats_end            (HDPluginStats *stats,
+                                               gint64         start);
+
+void           hd_plugin_stats_icon_update    (HDPluginStats *stats);
+
+void           hd_plugin_stats_dump           (FILE          *file);
+void           hd_plugin_stats_dump_on_signal (int            signum,
+                                               const gchar   *filename);
+
+G_END_DECLS
+
+#endif
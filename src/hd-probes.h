@@ -0,0 +1,66 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef __HD_PROBES_H__
+#define __HD_PROBES_H__
+
+/* Static user space tracepoints, provider hildon_status_menu. With
+ * <sys/sdt.h> each probe is a nop plus an ELF note, so they stay in
+ * release builds and can be attached to with perf, bpftrace or
+ * SystemTap, e.g.
+ *
+ *   perf probe -x hildon-status-menu sdt_hildon_status_menu:icon__changed
+ *
+ * Arguments are evaluated even when nothing is attached, keep them
+ * cheap. Without <sys/sdt.h> the probes compile to nothing.
+ *
+ * Probes and arguments:
+ *   plugin__added         plugin id
+ *   plugin__removed       plugin id
+ *   icon__changed         plugin id
+ *   visibility__changed   HDStatusAreaVisibilityReasons, visible
+ *   config__reload        number of configured plugins
+ *   menu__show
+ *   menu__map
+ *   menu__first__expose
+ *   area__check__resize   configure notify received
+ *   menu__check__resize   configure notify received
+ *   dbus__signal          interface, member
+ */
+
+#ifdef HAVE_SYS_SDT_H
+
+#include <sys/sdt.h>
+
+#define HD_PROBE0(name)          DTRACE_PROBE (hildon_status_menu, name)
+#define HD_PROBE1(name, a)       DTRACE_PROBE1 (hildon_status_menu, name, a)
+#define HD_PROBE2(name, a, b)    DTRACE_PROBE2 (hildon_status_menu, name, a, b)
+
+#else
+
+#define HD_PROBE0(name)          do { } while (0)
+#define HD_PROBE1(name, a)       do { } while (0)
+#define HD_PROBE2(name, a, b)    do { } while (0)
+
+#endif
+
+#endif
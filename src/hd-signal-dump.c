@@ -0,0 +1,245 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hd-signal-dump.h"
+
+typedef struct _SignalDump SignalDump;
+typedef struct _Writer     Writer;
+
+/* A file written when the process receives a signal */
+struct _SignalDump
+{
+  int     signum;
+  gchar  *filename;
+
+  /* Writers, in the order they were added */
+  GSList *writers;
+};
+
+struct _Writer
+{
+  HDSignalDumpFunc func;
+  gpointer         data;
+};
+
+static GSList *dumps = NULL;
+
+/* self-pipe carrying the signal numbers from the signal handler to the
+ * main loop */
+static int dump_pipe[2] = { -1, -1 };
+
+static SignalDump *
+lookup_dump (int signum)
+{
+  GSList *d;
+
+  for (d = dumps; d; d = d->next)
+    if (((SignalDump *) d->data)->signum == signum)
+      return d->data;
+
+  return NULL;
+}
+
+static void
+write_dump (SignalDump *dump)
+{
+  gchar *dir;
+  FILE *file;
+  GSList *w;
+
+  dir = g_path_get_dirname (dump->filename);
+  g_mkdir_with_parents (dir, 0755);
+  g_free (dir);
+
+  file = fopen (dump->filename, "w");
+  if (!file)
+    {
+      g_warning ("%s. Could not open %s. %s",
+                 __FUNCTION__,
+                 dump->filename,
+                 g_strerror (errno));
+      return;
+    }
+
+  for (w = dump->writers; w; w = w->next)
+    {
+      Writer *writer = w->data;
+
+      if (w != dump->writers)
+        fprintf (file, "\n");
+      writer->func (file, writer->data);
+    }
+
+  fclose (file);
+}
+
+static gboolean
+dump_pipe_cb (GIOChannel   *source,
+              GIOCondition  condition,
+              gpointer      data)
+{
+  guchar buf[16];
+  gboolean pending[NSIG] = { FALSE, };
+  GSList *d;
+  gssize n, i;
+
+  /* Drain, several signals result in one dump per file */
+  while ((n = read (dump_pipe[0], buf, sizeof (buf))) > 0)
+    for (i = 0; i < n; i++)
+      if (buf[i] < NSIG)
+        pending[buf[i]] = TRUE;
+
+  for (d = dumps; d; d = d->next)
+    {
+      SignalDump *dump = d->data;
+
+      if (pending[dump->signum])
+        write_dump (dump);
+    }
+
+  return TRUE;
+}
+
+static void
+dump_signal_handler (int signum)
+{
+  int saved_errno = errno;
+  guchar byte = signum;
+
+  if (write (dump_pipe[1], &byte, 1) < 0)
+    {
+      /* The pipe is full, dumps are pending anyway */
+    }
+
+  errno = saved_errno;
+}
+
+static gboolean
+create_dump_pipe (void)
+{
+  GIOChannel *channel;
+
+  if (pipe (dump_pipe) == -1)
+    {
+      g_warning ("%s. Could not create pipe. %s",
+                 __FUNCTION__,
+                 g_strerror (errno));
+      dump_pipe[0] = dump_pipe[1] = -1;
+      return FALSE;
+    }
+
+  fcntl (dump_pipe[0], F_SETFL, O_NONBLOCK);
+  fcntl (dump_pipe[1], F_SETFL, O_NONBLOCK);
+  fcntl (dump_pipe[0], F_SETFD, FD_CLOEXEC);
+  fcntl (dump_pipe[1], F_SETFD, FD_CLOEXEC);
+
+  channel = g_io_channel_unix_new (dump_pipe[0]);
+  g_io_add_watch (channel, G_IO_IN, dump_pipe_cb, NULL);
+  g_io_channel_unref (channel);
+
+  return TRUE;
+}
+
+/**
+ * hd_signal_dump_add:
+ * @signum: the signal which requests a dump
+ * @filename: the file written on @signum, the same for all writers of
+ * the signal
+ * @func: writes its part of the file
+ * @data: data passed to @func
+ *
+ * Calls @func with @filename opened for writing from the main loop
+ * whenever the process receives @signum. The signal handler only wakes
+ * up the main loop. Writers of the same signal share the file, in the
+ * order they were added, separated by an empty line.
+ **/
+void
+hd_signal_dump_add (int               signum,
+                    const gchar      *filename,
+                    HDSignalDumpFunc  func,
+                    gpointer          data)
+{
+  SignalDump *dump;
+  Writer *writer;
+
+  g_return_if_fail (signum > 0 && signum < NSIG);
+  g_return_if_fail (filename != NULL && func != NULL);
+
+  if (dump_pipe[0] == -1 && !create_dump_pipe ())
+    return;
+
+  dump = lookup_dump (signum);
+  if (!dump)
+    {
+      struct sigaction action;
+
+      dump = g_slice_new0 (SignalDump);
+      dump->signum = signum;
+      dump->filename = g_strdup (filename);
+      dumps = g_slist_prepend (dumps, dump);
+
+      memset (&action, 0, sizeof (action));
+      action.sa_handler = dump_signal_handler;
+      action.sa_flags = SA_RESTART;
+      sigemptyset (&action.sa_mask);
+      sigaction (signum, &action, NULL);
+    }
+  else if (strcmp (dump->filename, filename) != 0)
+    {
+      g_warning ("%s. Signal %d already writes %s, not %s",
+                 __FUNCTION__,
+                 signum,
+                 dump->filename,
+                 filename);
+      return;
+    }
+
+  writer = g_slice_new (Writer);
+  writer->func = func;
+  writer->data = data;
+  dump->writers = g_slist_append (dump->writers, writer);
+}
+
+/**
+ * hd_signal_dump_write:
+ * @signum: a signal passed to hd_signal_dump_add()
+ *
+ * Writes the file of @signum now, as if the signal was received.
+ **/
+void
+hd_signal_dump_write (int signum)
+{
+  SignalDump *dump = lookup_dump (signum);
+
+  if (dump)
+    write_dump (dump);
+}
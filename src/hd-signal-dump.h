@@ -0,0 +1,43 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef __HD_SIGNAL_DUMP_H__
+#define __HD_SIGNAL_DUMP_H__
+
+#include <glib.h>
+
+#include <stdio.h>
+
+G_BEGIN_DECLS
+
+typedef void (*HDSignalDumpFunc) (FILE     *file,
+                                  gpointer  data);
+
+void hd_signal_dump_add   (int               signum,
+                           const gchar      *filename,
+                           HDSignalDumpFunc  func,
+                           gpointer          data);
+void hd_signal_dump_write (int               signum);
+
+G_END_DECLS
+
+#endif
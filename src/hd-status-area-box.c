@@ -423,3 +423,51 @@ hd_status_area_box_reorder_child (HDStatusAreaBox *box,
     }
 }
 
+
+/*
+ * Reorder several children at once. @positions maps children to their new
+ * position (GUINT_TO_POINTER). The children list is sorted and the box is
+ * resized only once, whatever the number of moved children.
+ */
+void
+hd_status_area_box_reorder_children (HDStatusAreaBox *box,
+                                     GHashTable      *positions)
+{
+  HDStatusAreaBoxPrivate *priv;
+  gboolean reordered = FALSE, resize = FALSE;
+  GList *c;
+
+  g_return_if_fail (HD_IS_STATUS_AREA_BOX (box));
+  g_return_if_fail (positions != NULL);
+
+  priv = box->priv;
+
+  for (c = priv->children; c; c = c->next)
+    {
+      HDStatusAreaBoxChild *info = c->data;
+      gpointer value;
+      guint position;
+
+      if (!g_hash_table_lookup_extended (positions, info->widget, NULL, &value))
+        continue;
+
+      position = GPOINTER_TO_UINT (value);
+      if (info->priority == position)
+        continue;
+
+      info->priority = position;
+      reordered = TRUE;
+
+      if (GTK_WIDGET_VISIBLE (info->widget))
+        resize = TRUE;
+    }
+
+  if (!reordered)
+    return;
+
+  priv->children = g_list_sort (priv->children,
+                                hd_status_area_box_cmp_priority);
+
+  if (resize && GTK_WIDGET_VISIBLE (box))
+    gtk_widget_queue_resize (GTK_WIDGET (box));
+}
@@ -59,6 +59,8 @@ void       hd_status_area_box_pack          (HDStatusAreaBox *box,
 void       hd_status_area_box_reorder_child (HDStatusAreaBox *box,
                                              GtkWidget       *child,
                                              guint            position);
+void       hd_status_area_box_reorder_children (HDStatusAreaBox *box,
+                                                GHashTable      *positions);
 G_END_DECLS
 
 #endif /* __HD_STATUS_AREA_BOX_H__ */
@@ -33,10 +33,18 @@
 
 #include "hd-desktop.h"
 #include "hd-display.h"
+#include "hd-flight-recorder.h"
+#include "hd-memory-pressure.h"
+#include "hd-metrics.h"
 
 #include "hd-status-area-box.h"
 #include "hd-status-menu.h"
+#include "hd-plugin-stats.h"
+#include "hd-probes.h"
 #include "hd-status-menu-config.h"
+#include "hd-status-timer.h"
+#include "hd-time.h"
+#include "hd-x-stats.h"
 
 #include "hd-status-area.h"
 
@@ -50,6 +58,15 @@
 #define CUSTOM_MARGIN_9 9
 #define CUSTOM_MARGIN_10 10
 
+/* Icon changes are applied at most once per interval while the
+ * display is dimmed, and for plugins demoted for exceeding their quota */
+#define DEFERRED_UPDATE_INTERVAL 2000
+#define DEFERRED_UPDATE_SLACK 1000
+
+/* Icon redraws per second, the status timer has millisecond resolution
+ * and higher limits would round the interval down to 0, i.e. unlimited */
+#define MAX_ICON_RATE_LIMIT 1000
+
 /* Configuration file keys */
 
 #define HD_STATUS_AREA_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), HD_TYPE_STATUS_AREA, HDStatusAreaPrivate));
@@ -57,8 +74,51 @@
 static GQuark      quark_hd_status_area_image = 0;
 static const gchar hd_status_area_image[] = "hd_status_area_image";
 
-static GQuark      quark_hd_status_area_plugin_id = 0;
-static const gchar hd_status_area_plugin_id[] = "hd_status_area_plugin_id";
+/* Frames of an animated icon, uploaded to the X server once */
+typedef struct _HDStatusAreaAnimation HDStatusAreaAnimation;
+struct _HDStatusAreaAnimation
+{
+  /* kept to upload the frames again after they were trimmed */
+  GList      *pixbufs;
+
+  /* NULL until uploaded */
+  GdkPixmap **frames;
+  guint       n_frames;
+  guint       current;
+
+  gint        width;
+  gint        height;
+
+  guint       interval;
+  guint       tick_id;
+};
+
+/* Configuration applied to a loaded plugin, used to handle
+ * configuration reloads as a diff */
+typedef struct _HDStatusAreaItem HDStatusAreaItem;
+struct _HDStatusAreaItem
+{
+  HDStatusArea     *status_area;
+  GObject          *plugin;
+  const gchar      *plugin_id;  /* the key in the items table */
+  GtkWidget        *image;
+  HDStatusAreaSlot  slot;
+  guint             position;
+
+  /* accounting of the plugin id, may be NULL */
+  HDPluginStats    *stats;
+
+  /* icon redraw rate limit, 0 if unlimited */
+  guint             min_icon_interval;
+  gint64            last_icon_update;
+  guint             icon_flush_id;
+
+  /* set while the plugin shows an animation instead of its icon */
+  HDStatusAreaAnimation *animation;
+
+  /* The icon changed but was not applied yet */
+  guint             icon_dirty : 1;
+};
 
 enum
 {
@@ -72,8 +132,12 @@ struct _HDStatusAreaPrivate
 
   HDDesktop *desktop;
   HDDisplay *display;
+  HDMemoryPressure *memory_pressure;
   GList *status_plugins;
 
+  /* plugin id -> HDStatusAreaItem */
+  GHashTable *items;
+
   GtkWidget *status_menu;
 
   GtkWidget *icon_box;
@@ -86,10 +150,57 @@ struct _HDStatusAreaPrivate
 
   gboolean resize_after_map : 1;
   gboolean status_area_visible;
+  guint visibility_reasons;
+
+  /* Number of items with an icon change not applied yet */
+  guint n_dirty_items;
+
+  /* Shared timer service for the status area and its plugins */
+  HDStatusTimer *timer;
+
+  /* Applies deferred icon changes */
+  guint deferred_update_id;
+
+  /* Icon redraws and time spent per display state, without the time
+   * since the last state change */
+  HDDisplayState display_state;
+  guint          redraws[HD_DISPLAY_N_STATES];
+  gint64         display_state_ms[HD_DISPLAY_N_STATES];
+  gint64         display_state_since;
 };
 
+/* Registered on HDStatusPluginItem */
+static guint visibility_reasons_changed_signal = 0;
+static guint animation_signal = 0;
+
 G_DEFINE_TYPE (HDStatusArea, hd_status_area, GTK_TYPE_WINDOW);
 
+static void
+hd_status_area_item_free (HDStatusAreaItem *item)
+{
+  HDStatusAreaPrivate *priv = item->status_area->priv;
+
+  if (item->icon_flush_id && priv->timer)
+    hd_status_timer_remove (priv->timer, item->icon_flush_id);
+
+  g_slice_free (HDStatusAreaItem, item);
+}
+
+static void
+set_icon_rate_limit (HDStatusAreaItem *item,
+                     guint             icon_rate_limit)
+{
+  if (icon_rate_limit > MAX_ICON_RATE_LIMIT)
+    {
+      g_warning ("%s. Icon rate limit %u of %s is above %u per second, using %u",
+                 __FUNCTION__, icon_rate_limit, item->plugin_id,
+                 MAX_ICON_RATE_LIMIT, MAX_ICON_RATE_LIMIT);
+      icon_rate_limit = MAX_ICON_RATE_LIMIT;
+    }
+
+  item->min_icon_interval = icon_rate_limit ? 1000 / icon_rate_limit : 0;
+}
+
 static gboolean
 button_release_event_cb (GtkWidget      *widget,
                        GdkEventButton *event,
@@ -111,40 +222,193 @@ is_widget_on_screen (GtkWidget *widget)
 {
   GdkWindow *window;
   gint x, y, width, height;
+  HDXStatsSection section;
 
   window = gtk_widget_get_window (widget);
   if (!window)
     return FALSE;
 
+  hd_x_stats_begin (&section);
   gdk_window_get_root_origin (window, &x, &y);
   gdk_window_get_geometry (window, NULL, NULL, &width, &height, NULL);
+  hd_x_stats_end (&section, "status-area:is-widget-on-screen");
 
   /* the compositor moves obscured windows off the screen, so we can use
    * that to determine whether the status area is visible */
   return (x + width > 0) && (y + height > 0);
 }
 
+static const gchar *display_state_names[HD_DISPLAY_N_STATES] =
+{
+  "on",
+  "dim",
+  "off"
+};
+
+static void apply_status_area_icon        (HDStatusAreaItem *item);
+static void update_status_area_visibility (HDStatusArea     *status_area);
+static void memory_trim_cb                (HDMemoryPressure *memory_pressure,
+                                           HDStatusArea     *status_area);
+
+/* While the status area is not visible icon changes are only recorded
+ * and applied at once when it becomes visible again */
+static void
+thaw_status_area_icons (HDStatusArea *status_area)
+{
+  HDStatusAreaPrivate *priv = status_area->priv;
+  GHashTableIter iter;
+  gpointer value;
+
+  if (!priv->n_dirty_items)
+    return;
+
+  g_hash_table_iter_init (&iter, priv->items);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      HDStatusAreaItem *item = value;
+
+      if (item->icon_dirty)
+        {
+          gint64 start = hd_plugin_stats_begin (item->stats);
+
+          apply_status_area_icon (item);
+
+          hd_plugin_stats_end (item->stats, start);
+        }
+    }
+}
+
+static gboolean
+deferred_update_cb (HDStatusArea *status_area)
+{
+  HDStatusAreaPrivate *priv = status_area->priv;
+
+  priv->deferred_update_id = 0;
+
+  if (priv->status_area_visible)
+    thaw_status_area_icons (status_area);
+
+  return FALSE;
+}
+
+static void
+display_status_changed_cb (HDDisplay    *display,
+                           HDStatusArea *status_area)
+{
+  HDStatusAreaPrivate *priv = status_area->priv;
+  HDDisplayState state;
+  gint64 now;
+
+  state = hd_display_get_state (display);
+  if (state == priv->display_state)
+    return;
+
+  now = hd_time_get_monotonic_ms ();
+  priv->display_state_ms[priv->display_state] += now - priv->display_state_since;
+  priv->display_state = state;
+  priv->display_state_since = now;
+
+  /* Changes delayed by the dimmed display are applied right away
+   * when it is turned on, and kept when it is turned off */
+  if (state != HD_DISPLAY_STATE_DIM && priv->deferred_update_id)
+    {
+      hd_status_timer_remove (priv->timer, priv->deferred_update_id);
+      priv->deferred_update_id = 0;
+    }
+
+  update_status_area_visibility (status_area);
+
+  if (state == HD_DISPLAY_STATE_ON && priv->status_area_visible)
+    thaw_status_area_icons (status_area);
+}
+
+static void
+set_plugin_visibility_reasons (GObject *plugin,
+                               guint    reasons)
+{
+  HDPluginStats *stats = hd_plugin_stats_lookup (plugin);
+  gint64 start = hd_plugin_stats_begin (stats);
+
+  g_object_set_data (plugin, HD_STATUS_AREA_VISIBILITY_REASONS_KEY,
+                     GUINT_TO_POINTER (reasons));
+  g_signal_emit (plugin, visibility_reasons_changed_signal, 0, reasons);
+
+  hd_plugin_stats_end (stats, start);
+}
+
+static void
+set_plugin_visible (GObject  *plugin,
+                    gboolean  visible)
+{
+  HDPluginStats *stats = hd_plugin_stats_lookup (plugin);
+  gint64 start = hd_plugin_stats_begin (stats);
+
+  /* The plugin starts or stops its updates in the notify handler */
+  g_object_set (plugin, "status-area-visible", visible, NULL);
+
+  hd_plugin_stats_end (stats, start);
+}
+
 static void
 update_status_area_visibility (HDStatusArea *status_area)
 {
   HDStatusAreaPrivate *priv = status_area->priv;
   gboolean visible;
+  guint reasons = 0;
+  gint64 start;
   GList *l;
 
-  visible = (is_widget_on_screen (GTK_WIDGET (status_area)) &&
-             !hd_desktop_is_task_switcher_visible (priv->desktop) &&
-             hd_display_is_on (priv->display));
+  if (!is_widget_on_screen (GTK_WIDGET (status_area)))
+    reasons |= HD_STATUS_AREA_VISIBILITY_OFF_SCREEN;
+  if (hd_desktop_is_task_switcher_visible (priv->desktop))
+    reasons |= HD_STATUS_AREA_VISIBILITY_TASK_SWITCHER;
+  switch (hd_display_get_state (priv->display))
+    {
+    case HD_DISPLAY_STATE_OFF:
+      reasons |= HD_STATUS_AREA_VISIBILITY_DISPLAY_OFF;
+      break;
+    case HD_DISPLAY_STATE_DIM:
+      reasons |= HD_STATUS_AREA_VISIBILITY_DISPLAY_DIMMED;
+      break;
+    default:
+      break;
+    }
+
+  /* status_area_visible follows from visibility_reasons, both are
+   * initialized consistently in hd_status_area_init () */
+  if (reasons == priv->visibility_reasons)
+    return;
+
+  priv->visibility_reasons = reasons;
+  start = hd_metrics_begin ();
+
+  HD_PROBE2 (visibility__changed, reasons,
+             !(reasons & HD_STATUS_AREA_VISIBILITY_HIDDEN_MASK));
+
+  /* let plugins choose how much work to do while not visible */
+  for (l = priv->status_plugins; l; l = l->next)
+    set_plugin_visibility_reasons (l->data, reasons);
+
+  visible = !(reasons & HD_STATUS_AREA_VISIBILITY_HIDDEN_MASK);
 
   if (visible != priv->status_area_visible)
     {
       priv->status_area_visible = visible;
 
+      /* no timer wakeups for plugins while nothing can be seen */
+      hd_status_timer_set_paused (priv->timer, !visible);
+
       /* inform status area plugins if the status area is obscured or not */
       for (l = priv->status_plugins; l; l = l->next)
         {
-          g_object_set (l->data, "status-area-visible", visible, NULL);
+          set_plugin_visible (l->data, visible);
         }
+
+      if (visible)
+        thaw_status_area_icons (status_area);
     }
+
+  HD_METRICS_END ("visibility-transition", start);
 }
 
 static gboolean
@@ -171,18 +435,36 @@ hd_status_area_init (HDStatusArea *status_area)
   /* Set priv member */
   status_area->priv = priv;
 
+  priv->timer = hd_status_timer_new ();
+  hd_status_timer_set_paused (priv->timer, TRUE);
+
   priv->desktop = hd_desktop_get ();
   g_signal_connect_swapped (priv->desktop, "task-switcher-show",
                             G_CALLBACK (update_status_area_visibility), status_area);
   g_signal_connect_swapped (priv->desktop, "task-switcher-hide",
                             G_CALLBACK (update_status_area_visibility), status_area);
   priv->display = hd_display_get ();
-  g_signal_connect_swapped (priv->display, "display-status-changed",
-                            G_CALLBACK (update_status_area_visibility), status_area);
+  priv->display_state = hd_display_get_state (priv->display);
+  priv->display_state_since = hd_time_get_monotonic_ms ();
+  g_signal_connect (priv->display, "display-status-changed",
+                    G_CALLBACK (display_status_changed_cb), status_area);
+
+  /* Not mapped yet. The reasons and the visibility must agree, the
+   * update only changes the visibility when the reasons change */
+  priv->visibility_reasons = HD_STATUS_AREA_VISIBILITY_OFF_SCREEN;
+  priv->status_area_visible = FALSE;
   update_status_area_visibility (status_area);
 
+  priv->memory_pressure = hd_memory_pressure_get ();
+  g_signal_connect (priv->memory_pressure, "trim",
+                    G_CALLBACK (memory_trim_cb), status_area);
+
   priv->status_plugins = NULL;
 
+  priv->items = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                       (GDestroyNotify) g_free,
+                                       (GDestroyNotify) hd_status_area_item_free);
+
   /* Create Status area UI */
   gtk_widget_add_events (GTK_WIDGET (status_area), GDK_BUTTON_RELEASE_MASK);
   g_signal_connect (G_OBJECT (status_area), "button-release-event",
@@ -280,11 +562,28 @@ hd_status_area_dispose (GObject *object)
   if (priv->display)
     {
       g_signal_handlers_disconnect_by_func (priv->display,
-                                            update_status_area_visibility,
+                                            display_status_changed_cb,
                                             status_area);
       priv->display = (g_object_unref (priv->display), NULL);
     }
 
+  if (priv->memory_pressure)
+    {
+      g_signal_handlers_disconnect_by_func (priv->memory_pressure,
+                                            memory_trim_cb,
+                                            status_area);
+      priv->memory_pressure = (g_object_unref (priv->memory_pressure), NULL);
+    }
+
+  if (priv->timer)
+    {
+      if (priv->deferred_update_id)
+        hd_status_timer_remove (priv->timer, priv->deferred_update_id);
+      priv->deferred_update_id = 0;
+
+      priv->timer = (g_object_unref (priv->timer), NULL);
+    }
+
   G_OBJECT_CLASS (hd_status_area_parent_class)->dispose (object);
 }
 
@@ -296,24 +595,47 @@ hd_status_area_finalize (GObject *object)
   if (priv->special_item_image)
     priv->special_item_image = (g_free (priv->special_item_image), NULL);
 
+  if (priv->items)
+    priv->items = (g_hash_table_destroy (priv->items), NULL);
+
   G_OBJECT_CLASS (hd_status_area_parent_class)->finalize (object);
 }
 
 static void
-status_area_icon_changed (HDStatusPluginItem *plugin)
+apply_status_area_icon (HDStatusAreaItem *item)
 {
-  GtkWidget *image;
-  GdkPixbuf *pixbuf;
+  HDStatusAreaPrivate *priv = item->status_area->priv;
+  GdkPixbuf *pixbuf, *old_pixbuf = NULL;
+  gboolean was_visible;
+  gint64 start = hd_metrics_begin ();
+
+  if (item->icon_dirty)
+    {
+      item->icon_dirty = FALSE;
+      priv->n_dirty_items--;
+    }
+  item->last_icon_update = hd_time_get_monotonic_ms ();
+  priv->redraws[priv->display_state]++;
 
-  /* Get the image connected with the plugin */
-  image = g_object_get_qdata (G_OBJECT (plugin),
-                              quark_hd_status_area_image);
+  was_visible = GTK_WIDGET_VISIBLE (item->image);
+  if (gtk_image_get_storage_type (GTK_IMAGE (item->image)) == GTK_IMAGE_PIXBUF)
+    old_pixbuf = gtk_image_get_pixbuf (GTK_IMAGE (item->image));
 
   /* Update icon */
-  g_object_get (G_OBJECT (plugin),
+  g_object_get (item->plugin,
                 "status-area-icon", &pixbuf,
                 NULL);
-  gtk_image_set_from_pixbuf (GTK_IMAGE (image), pixbuf);
+
+  /* Icons in the icon box change its size if they appear, disappear or
+   * change their dimensions, the special item images have a fixed size */
+  if (item->stats && item->slot == HD_STATUS_AREA_SLOT_NONE &&
+      (was_visible != (pixbuf != NULL) ||
+       (pixbuf && old_pixbuf &&
+        (gdk_pixbuf_get_width (pixbuf) != gdk_pixbuf_get_width (old_pixbuf) ||
+         gdk_pixbuf_get_height (pixbuf) != gdk_pixbuf_get_height (old_pixbuf)))))
+    item->stats->resizes++;
+
+  gtk_image_set_from_pixbuf (GTK_IMAGE (item->image), pixbuf);
 
   /*
   g_debug ("status_area_icon_changed. plugin: %s, icon %x",
@@ -326,10 +648,319 @@ status_area_icon_changed (HDStatusPluginItem *plugin)
     {
       g_object_unref (pixbuf);
 
-      gtk_widget_show (image);
+      gtk_widget_show (item->image);
     }
   else
-    gtk_widget_hide (image);
+    gtk_widget_hide (item->image);
+
+  HD_METRICS_END ("icon-apply", start);
+}
+
+static void
+mark_icon_dirty (HDStatusAreaItem *item)
+{
+  if (!item->icon_dirty)
+    {
+      item->icon_dirty = TRUE;
+      item->status_area->priv->n_dirty_items++;
+
+      HD_METRICS_COUNT ("icon-updates-deferred");
+    }
+}
+
+static gboolean
+icon_flush_cb (HDStatusAreaItem *item)
+{
+  item->icon_flush_id = 0;
+
+  /* Show the final state of a burst of updates */
+  if (item->icon_dirty && item->status_area->priv->status_area_visible)
+    {
+      gint64 start = hd_plugin_stats_begin (item->stats);
+
+      apply_status_area_icon (item);
+
+      hd_plugin_stats_end (item->stats, start);
+    }
+
+  return FALSE;
+}
+
+static void
+status_area_icon_changed (HDStatusPluginItem *plugin,
+                          GParamSpec         *pspec,
+                          HDStatusAreaItem   *item)
+{
+  HDStatusAreaPrivate *priv = item->status_area->priv;
+
+  HD_PROBE1 (icon__changed, item->plugin_id);
+
+  hd_plugin_stats_icon_update (item->stats);
+  HD_METRICS_COUNT ("icon-updates");
+
+  /* The animation is shown instead, the icon is applied when it stops */
+  if (item->animation)
+    return;
+
+  if (priv->status_area_visible &&
+      priv->display_state != HD_DISPLAY_STATE_DIM &&
+      !(item->stats && item->stats->demoted))
+    {
+      gint64 start, since_update;
+
+      /* Above the rate limit only the latest icon is applied when the
+       * interval is over */
+      since_update = hd_time_get_monotonic_ms () - item->last_icon_update;
+      if (item->min_icon_interval && since_update < item->min_icon_interval)
+        {
+          mark_icon_dirty (item);
+
+          if (!item->icon_flush_id)
+            item->icon_flush_id = hd_status_timer_add (priv->timer,
+                                                       item->min_icon_interval - since_update,
+                                                       0,
+                                                       (GSourceFunc) icon_flush_cb,
+                                                       item);
+          return;
+        }
+
+      start = hd_plugin_stats_begin (item->stats);
+
+      apply_status_area_icon (item);
+
+      hd_plugin_stats_end (item->stats, start);
+      return;
+    }
+
+  /* Frozen, dimmed or demoted, only the latest icon is fetched when the
+   * status area gets visible again or on the next deferred update */
+  mark_icon_dirty (item);
+
+  if (priv->status_area_visible && !priv->deferred_update_id)
+    priv->deferred_update_id = hd_status_timer_add (priv->timer,
+                                                    DEFERRED_UPDATE_INTERVAL,
+                                                    DEFERRED_UPDATE_SLACK,
+                                                    (GSourceFunc) deferred_update_cb,
+                                                    item->status_area);
+}
+
+static void
+upload_animation_frames (HDStatusAreaAnimation *animation,
+                         GtkWidget             *image)
+{
+  GList *p;
+  guint i;
+
+  if (animation->frames || !GTK_WIDGET_REALIZED (image))
+    return;
+
+  animation->frames = g_new0 (GdkPixmap *, animation->n_frames);
+
+  for (p = animation->pixbufs, i = 0; p; p = p->next, i++)
+    {
+      GdkPixbuf *pixbuf = p->data;
+      cairo_t *cr;
+
+      /* Same depth as the ARGB status area window */
+      animation->frames[i] = gdk_pixmap_new (image->window,
+                                             animation->width,
+                                             animation->height,
+                                             -1);
+
+      cr = gdk_cairo_create (GDK_DRAWABLE (animation->frames[i]));
+      cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+      cairo_set_source_rgba (cr, 0.0, 0.0, 0.0, 0.0);
+      cairo_paint (cr);
+      gdk_cairo_set_source_pixbuf (cr, pixbuf,
+                                   (animation->width - gdk_pixbuf_get_width (pixbuf)) / 2,
+                                   (animation->height - gdk_pixbuf_get_height (pixbuf)) / 2);
+      cairo_paint (cr);
+      cairo_destroy (cr);
+    }
+}
+
+static void
+free_animation_frames (HDStatusAreaAnimation *animation)
+{
+  guint i;
+
+  if (!animation->frames)
+    return;
+
+  for (i = 0; i < animation->n_frames; i++)
+    g_object_unref (animation->frames[i]);
+
+  g_free (animation->frames);
+  animation->frames = NULL;
+}
+
+/* Copies the current frame to the window, without going through the
+ * GtkImage and the size negotiation */
+static void
+draw_animation_frame (HDStatusAreaItem *item)
+{
+  HDStatusAreaAnimation *animation = item->animation;
+  GtkWidget *image = item->image;
+  cairo_t *cr;
+  gint x, y;
+
+  if (!GTK_WIDGET_DRAWABLE (image))
+    return;
+
+  upload_animation_frames (animation, image);
+  if (!animation->frames)
+    return;
+
+  x = image->allocation.x + (image->allocation.width - animation->width) / 2;
+  y = image->allocation.y + (image->allocation.height - animation->height) / 2;
+
+  cr = gdk_cairo_create (GDK_DRAWABLE (image->window));
+  cairo_rectangle (cr, x, y, animation->width, animation->height);
+  cairo_clip (cr);
+  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+  gdk_cairo_set_source_pixmap (cr, animation->frames[animation->current], x, y);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+}
+
+static gboolean
+animation_expose_cb (GtkWidget        *image,
+                     GdkEventExpose   *event,
+                     HDStatusAreaItem *item)
+{
+  draw_animation_frame (item);
+
+  return TRUE;
+}
+
+static gboolean
+animation_tick_cb (HDStatusAreaItem *item)
+{
+  HDStatusAreaAnimation *animation = item->animation;
+  gint64 start = hd_plugin_stats_begin (item->stats);
+
+  if (animation->n_frames)
+    animation->current = (animation->current + 1) % animation->n_frames;
+
+  draw_animation_frame (item);
+  item->status_area->priv->redraws[item->status_area->priv->display_state]++;
+
+  hd_plugin_stats_end (item->stats, start);
+
+  return TRUE;
+}
+
+static void
+stop_animation (HDStatusAreaItem *item)
+{
+  HDStatusAreaPrivate *priv = item->status_area->priv;
+  HDStatusAreaAnimation *animation = item->animation;
+
+  if (!animation)
+    return;
+
+  item->animation = NULL;
+
+  if (animation->tick_id && priv->timer)
+    hd_status_timer_remove (priv->timer, animation->tick_id);
+
+  g_signal_handlers_disconnect_by_func (item->image,
+                                        animation_expose_cb,
+                                        item);
+
+  free_animation_frames (animation);
+
+  g_list_foreach (animation->pixbufs, (GFunc) g_object_unref, NULL);
+  g_list_free (animation->pixbufs);
+
+  g_slice_free (HDStatusAreaAnimation, animation);
+
+  /* Special item images keep their fixed size */
+  if (item->slot == HD_STATUS_AREA_SLOT_NONE)
+    gtk_widget_set_size_request (item->image, -1, -1);
+}
+
+/* Handler of the ::status-area-animation action signal of plugins */
+static void
+status_area_animation_cb (HDStatusPluginItem *plugin,
+                          guint               interval,
+                          GList              *frames,
+                          HDStatusAreaItem   *item)
+{
+  HDStatusAreaPrivate *priv = item->status_area->priv;
+  HDStatusAreaAnimation *animation;
+  GList *f;
+
+  stop_animation (item);
+
+  if (!frames || !interval)
+    {
+      /* Back to the status-area-icon */
+      mark_icon_dirty (item);
+      if (priv->status_area_visible)
+        apply_status_area_icon (item);
+      return;
+    }
+
+  animation = g_slice_new0 (HDStatusAreaAnimation);
+  animation->interval = interval;
+
+  for (f = frames; f; f = f->next)
+    {
+      GdkPixbuf *pixbuf = f->data;
+
+      animation->width = MAX (animation->width, gdk_pixbuf_get_width (pixbuf));
+      animation->height = MAX (animation->height, gdk_pixbuf_get_height (pixbuf));
+      animation->pixbufs = g_list_prepend (animation->pixbufs,
+                                           g_object_ref (pixbuf));
+    }
+  animation->pixbufs = g_list_reverse (animation->pixbufs);
+  animation->n_frames = g_list_length (animation->pixbufs);
+
+  item->animation = animation;
+
+  /* The image only reserves the space, frames are drawn directly */
+  gtk_image_clear (GTK_IMAGE (item->image));
+  if (item->slot == HD_STATUS_AREA_SLOT_NONE)
+    gtk_widget_set_size_request (item->image, animation->width, animation->height);
+  gtk_widget_show (item->image);
+
+  g_signal_connect (item->image, "expose-event",
+                    G_CALLBACK (animation_expose_cb), item);
+
+  upload_animation_frames (animation, item->image);
+
+  /* Frame ticks stop with the timer service while not visible */
+  animation->tick_id = hd_status_timer_add (priv->timer,
+                                            interval,
+                                            interval / 4,
+                                            (GSourceFunc) animation_tick_cb,
+                                            item);
+
+  gtk_widget_queue_draw (item->image);
+}
+
+/* Animation frames live in the X server, they are uploaded again from
+ * the pixbufs when the status area is visible again */
+static void
+memory_trim_cb (HDMemoryPressure *memory_pressure,
+                HDStatusArea     *status_area)
+{
+  HDStatusAreaPrivate *priv = status_area->priv;
+  GHashTableIter iter;
+  gpointer value;
+
+  if (priv->status_area_visible)
+    return;
+
+  g_hash_table_iter_init (&iter, priv->items);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      HDStatusAreaItem *item = value;
+
+      if (item->animation)
+        free_animation_frames (item->animation);
+    }
 }
 
 static void
@@ -340,9 +971,8 @@ hd_status_area_plugin_added_cb (HDPluginManager *plugin_manager,
   HDStatusAreaPrivate *priv = status_area->priv;
   gchar *plugin_id;
   GtkWidget *image = NULL;
-  GKeyFile *keyfile;
-  gchar *permanent_item;
-  guint i;
+  const HDStatusMenuConfigRecord *record;
+  HDStatusAreaItem *item;
 
   /* Plugin must be a HDStatusMenuItem */
   if (!HD_IS_STATUS_PLUGIN_ITEM (plugin))
@@ -351,19 +981,31 @@ hd_status_area_plugin_added_cb (HDPluginManager *plugin_manager,
   g_object_ref (plugin);
 
   /* Read position in Status Menu from plugin configuration */
-  keyfile = hd_plugin_manager_get_plugin_config_key_file (plugin_manager);
   plugin_id = hd_plugin_item_get_plugin_id (HD_PLUGIN_ITEM (plugin));
 
-  /* Check if the plugin one of the permament plugins on the left
-   * side of the Status Area
-   */
-  permanent_item = g_key_file_get_string (keyfile,
-                                          plugin_id,
-                                          HD_STATUS_AREA_CONFIG_KEY_PERMANENT_ITEM,
-                                          NULL);
+  record = hd_status_menu_config_lookup (plugin_id);
+
+  item = g_slice_new0 (HDStatusAreaItem);
+  item->status_area = status_area;
+  item->plugin = plugin;
+  item->plugin_id = plugin_id;
+  item->stats = hd_plugin_stats_lookup (plugin);
+  set_icon_rate_limit (item, record->icon_rate_limit);
+  item->slot = record->slot;
+  item->position = G_MAXUINT;
+  g_hash_table_insert (priv->items, plugin_id, item);
+
+  HD_PROBE1 (plugin__added, plugin_id);
+
+  /* Before the clock returns below, its timer pauses with the status
+   * area like the timers of the other plugins */
+  priv->status_plugins = g_list_prepend (priv->status_plugins, plugin);
+  set_plugin_visible (plugin, priv->status_area_visible);
+  set_plugin_visibility_reasons (plugin, priv->visibility_reasons);
+  g_object_set_data (plugin, HD_STATUS_TIMER_KEY, priv->timer);
 
   /* Check if plugin is the special permanent clock plugin */
-  if (permanent_item && strcmp (HD_STATUS_AREA_CONFIG_VALUE_CLOCK, permanent_item) == 0)
+  if (item->slot == HD_STATUS_AREA_SLOT_CLOCK)
     {
       GtkWidget *clock_widget;
 
@@ -375,63 +1017,41 @@ hd_status_area_plugin_added_cb (HDPluginManager *plugin_manager,
 
       g_object_unref (clock_widget);
 
-      g_free (plugin_id);
       return;
     }
 
-  /* Check if plugin is the special permanent item */
-  for (i = 0; i < HD_STATUS_AREA_NUM_SPECIAL_ITEMS; i++)
+  /* Check if the plugin one of the permament plugins on the left
+   * side of the Status Area
+   */
+  if (item->slot >= HD_STATUS_AREA_SLOT_SPECIAL_ITEM)
     {
-      gchar *value = g_strdup_printf (HD_STATUS_AREA_CONFIG_VALUE_SPECIAL_ITEM, i);
-
-      if (permanent_item && strcmp (value, permanent_item) == 0)
-        {
-          image = priv->special_item_image [i];
-          g_object_set_qdata_full (plugin, quark_hd_status_area_image, image, (GDestroyNotify) gtk_widget_destroy);
-
-          g_free (value);
-          break;
-        }
-
-      g_free (value);
+      /* The special item images are owned by the status area,
+       * they are reused if the plugin is removed */
+      image = priv->special_item_image [item->slot - HD_STATUS_AREA_SLOT_SPECIAL_ITEM];
+      g_object_set_qdata (plugin, quark_hd_status_area_image, image);
     }
-
-  if (!image)
+  else
     {
-      guint position;
-      GError *error = NULL;
-
       /* Create GtkImage to display the icon */
       image = gtk_image_new ();
       g_object_set_qdata_full (plugin, quark_hd_status_area_image,
                                image, (GDestroyNotify) gtk_widget_destroy);
-      g_object_set_qdata_full (G_OBJECT (image), quark_hd_status_area_plugin_id,
-                               g_strdup (plugin_id), (GDestroyNotify) g_free);
 
       /* Get position */
-      position = (guint) g_key_file_get_integer (keyfile,
-                                                 plugin_id,
-                                                 HD_STATUS_AREA_CONFIG_KEY_POSITION,
-                                                 &error);
-      if (error)
-        {
-          g_error_free (error);
-          position = G_MAXUINT;
-        }
+      item->position = record->area_position;
 
       hd_status_area_box_pack (HD_STATUS_AREA_BOX (priv->icon_box),
                                image,
-                               position);
+                               item->position);
     }
 
-  priv->status_plugins = g_list_prepend (priv->status_plugins, plugin);
-  g_object_set (plugin, "status-area-visible", priv->status_area_visible, NULL);
+  item->image = image;
 
   g_signal_connect (plugin, "notify::status-area-icon",
-                    G_CALLBACK (status_area_icon_changed), NULL);
-  status_area_icon_changed (HD_STATUS_PLUGIN_ITEM (plugin));
-
-  g_free (plugin_id);
+                    G_CALLBACK (status_area_icon_changed), item);
+  g_signal_connect (plugin, HD_STATUS_AREA_ANIMATION_SIGNAL,
+                    G_CALLBACK (status_area_animation_cb), item);
+  status_area_icon_changed (HD_STATUS_PLUGIN_ITEM (plugin), NULL, item);
 }
 
 static void
@@ -448,19 +1068,43 @@ hd_status_area_plugin_removed_cb (HDPluginManager *plugin_manager,
                                   HDStatusArea    *status_area)
 {
   HDStatusAreaPrivate *priv = status_area->priv;
+  HDStatusAreaItem *item;
+  GtkWidget *image;
+  gchar *plugin_id;
 
   /* Plugin must be a HDStatusMenuItem */
   if (!HD_IS_STATUS_PLUGIN_ITEM (plugin))
     return;
 
-  if (g_object_get_qdata (plugin, quark_hd_status_area_image))
+  plugin_id = hd_plugin_item_get_plugin_id (HD_PLUGIN_ITEM (plugin));
+  item = g_hash_table_lookup (priv->items, plugin_id);
+
+  HD_PROBE1 (plugin__removed, plugin_id);
+
+  image = g_object_get_qdata (plugin, quark_hd_status_area_image);
+  if (image)
     {
-      /* Disconnect signal handler */
+      /* Special item images are kept for the next plugin in the slot */
+      gboolean special_item = gtk_widget_get_parent (image) != priv->icon_box;
+
+      if (item)
+        stop_animation (item);
+
+      /* Disconnect signal handlers */
       g_signal_handlers_disconnect_by_func (plugin,
                                             status_area_icon_changed,
-                                            NULL);
+                                            item);
+      g_signal_handlers_disconnect_by_func (plugin,
+                                            status_area_animation_cb,
+                                            item);
       /* Reset image and destroy it if created in plugin_added_cb */
       g_object_set_qdata (plugin, quark_hd_status_area_image, NULL);
+
+      if (special_item)
+        {
+          gtk_image_clear (GTK_IMAGE (image));
+          gtk_widget_hide (image);
+        }
     }
   else
     {
@@ -470,47 +1114,78 @@ hd_status_area_plugin_removed_cb (HDPluginManager *plugin_manager,
                              priv->clock_box);
     }
 
+  if (item && item->icon_dirty)
+    priv->n_dirty_items--;
+  g_hash_table_remove (priv->items, plugin_id);
+  g_free (plugin_id);
+
+  /* Also for the clock, which has no image */
+  g_object_set_data (plugin, HD_STATUS_TIMER_KEY, NULL);
+
   priv->status_plugins = g_list_remove (priv->status_plugins, plugin);
   g_object_unref (plugin);
 }
 
 static void
-update_position (GtkWidget *child,
-                 GKeyFile  *keyfile)
+hd_status_area_items_configuration_loaded_cb (HDPluginManager *plugin_manager,
+                                               GKeyFile        *key_file,
+                                               HDStatusArea    *status_area)
 {
-  gchar *plugin_id;
-  guint position;
-  GError *error = NULL;
+  HDStatusAreaPrivate *priv = status_area->priv;
+  const GSList *c;
+  GHashTable *positions = NULL;
+  GSList *moved_plugins = NULL, *p;
 
-  plugin_id = g_object_get_qdata (G_OBJECT (child), quark_hd_status_area_plugin_id);
+  /* Only touch plugins whose configuration changed with this load */
+  for (c = hd_status_menu_config_get_changed (); c; c = c->next)
+    {
+      const HDStatusMenuConfigRecord *record;
+      HDStatusAreaItem *item;
 
-  /* Get the position from the plugin configuration file */
-  position = (guint) g_key_file_get_integer (keyfile,
-                                             plugin_id,
-                                             HD_STATUS_AREA_CONFIG_KEY_POSITION,
-                                             &error);
+      item = g_hash_table_lookup (priv->items, c->data);
+      if (!item)
+        continue;
 
-  /* Use G_MAXUINT as default */
-  if (error)
-    {
-      g_error_free (error);
-      position = G_MAXUINT;
-    }
+      record = hd_status_menu_config_lookup (c->data);
 
-  /* Reorder Child */
-  hd_status_area_box_reorder_child (HD_STATUS_AREA_BOX (gtk_widget_get_parent (child)),
-                                    child,
-                                    position);
-}
+      if (record->slot != item->slot)
+        {
+          /* Moved from or to a permanent slot, add it again after the
+           * iteration */
+          moved_plugins = g_slist_prepend (moved_plugins,
+                                           g_object_ref (item->plugin));
+          continue;
+        }
 
-static void
-hd_status_area_items_configuration_loaded_cb (HDPluginManager *plugin_manager,
-                                               GKeyFile        *key_file,
-                                               HDStatusArea    *status_area)
-{
-  HDStatusAreaPrivate *priv = status_area->priv;
+      set_icon_rate_limit (item, record->icon_rate_limit);
+
+      if (item->slot != HD_STATUS_AREA_SLOT_NONE ||
+          record->area_position == item->position)
+        continue;
+
+      item->position = record->area_position;
+
+      if (!positions)
+        positions = g_hash_table_new (g_direct_hash, g_direct_equal);
+      g_hash_table_insert (positions, item->image,
+                           GUINT_TO_POINTER (item->position));
+    }
+
+  /* Apply all moves with a single reorder */
+  if (positions)
+    {
+      hd_status_area_box_reorder_children (HD_STATUS_AREA_BOX (priv->icon_box),
+                                           positions);
+      g_hash_table_destroy (positions);
+    }
 
-  gtk_container_foreach (GTK_CONTAINER (priv->icon_box), (GtkCallback) update_position, key_file);
+  for (p = moved_plugins; p; p = p->next)
+    {
+      hd_status_area_plugin_removed_cb (plugin_manager, p->data, status_area);
+      hd_status_area_plugin_added_cb (plugin_manager, p->data, status_area);
+      g_object_unref (p->data);
+    }
+  g_slist_free (moved_plugins);
 }
 
 static void
@@ -601,6 +1276,7 @@ hd_status_area_realize (GtkWidget *widget)
   Atom atom, wm_type;
   GdkPixmap *pixmap;
   cairo_t *cr;
+  HDXStatsSection section;
 
   screen = gtk_widget_get_screen (widget);
   gtk_widget_set_colormap (widget,
@@ -621,10 +1297,12 @@ hd_status_area_realize (GtkWidget *widget)
 
   /* Set the _NET_WM_WINDOW_TYPE property to _HILDON_WM_WINDOW_TYPE_STATUS_AREA */
   display = gdk_drawable_get_display (widget->window);
+  hd_x_stats_begin (&section);
   atom = gdk_x11_get_xatom_by_name_for_display (display,
                                                 "_NET_WM_WINDOW_TYPE");
   wm_type = gdk_x11_get_xatom_by_name_for_display (display,
                                                    "_HILDON_WM_WINDOW_TYPE_STATUS_AREA");
+  hd_x_stats_end (&section, "status-area:realize-atoms");
 
   XChangeProperty (GDK_WINDOW_XDISPLAY (widget->window),
                    GDK_WINDOW_XID (widget->window),
@@ -673,6 +1351,12 @@ hd_status_area_check_resize (GtkContainer *container)
   HDStatusAreaPrivate *priv = HD_STATUS_AREA (container)->priv;
   GtkWindow *window = GTK_WINDOW (container);
   GtkWidget *widget = GTK_WIDGET (container);
+  HDXStatsSection section;
+  gint64 start = hd_flight_recorder_begin ();
+  gint64 layout_start = hd_metrics_begin ();
+
+  /* bitfield, sizeof can not be applied */
+  HD_PROBE1 (area__check__resize, (gint) window->configure_notify_received);
 
   /* Handle a resize based on a configure notify event
    *
@@ -689,7 +1373,9 @@ hd_status_area_check_resize (GtkContainer *container)
       allocation = widget->allocation;
       gtk_widget_size_allocate (widget, &allocation);
 
+      hd_x_stats_begin (&section);
       gdk_window_process_updates (widget->window, TRUE);
+      hd_x_stats_end (&section, "status-area:check-resize-updates");
       
       gdk_window_configure_finished (widget->window);
 
@@ -698,6 +1384,9 @@ hd_status_area_check_resize (GtkContainer *container)
        */
       gtk_widget_queue_resize (widget);
 
+      hd_flight_recorder_end (HD_FLIGHT_EVENT_LAYOUT, start, 1, "status-area");
+      HD_METRICS_END ("status-area-layout", layout_start);
+
       return;
     }
 
@@ -726,6 +1415,9 @@ hd_status_area_check_resize (GtkContainer *container)
       /* Resize children (also if size not changed and so no
          configure notify event is triggered) */
       gtk_container_resize_children (GTK_CONTAINER (widget));
+
+      hd_flight_recorder_end (HD_FLIGHT_EVENT_LAYOUT, start, 0, "status-area");
+      HD_METRICS_END ("status-area-layout", layout_start);
     }
 }
 
@@ -737,7 +1429,28 @@ hd_status_area_class_init (HDStatusAreaClass *klass)
   GtkContainerClass *container_class = GTK_CONTAINER_CLASS (klass);
 
   quark_hd_status_area_image = g_quark_from_static_string (hd_status_area_image);
-  quark_hd_status_area_plugin_id = g_quark_from_static_string (hd_status_area_plugin_id);
+
+  /* Status plugins are created by libhildondesktop, so the signal is
+   * added to their type from here */
+  visibility_reasons_changed_signal = g_signal_new (HD_STATUS_AREA_VISIBILITY_REASONS_CHANGED_SIGNAL,
+                                                    HD_TYPE_STATUS_PLUGIN_ITEM,
+                                                    G_SIGNAL_RUN_LAST,
+                                                    0,
+                                                    NULL, NULL,
+                                                    g_cclosure_marshal_VOID__UINT,
+                                                    G_TYPE_NONE, 1,
+                                                    G_TYPE_UINT);
+
+  /* Action signal emitted by the plugins, see hd-status-area.h */
+  animation_signal = g_signal_new (HD_STATUS_AREA_ANIMATION_SIGNAL,
+                                   HD_TYPE_STATUS_PLUGIN_ITEM,
+                                   G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+                                   0,
+                                   NULL, NULL,
+                                   g_cclosure_marshal_VOID__UINT_POINTER,
+                                   G_TYPE_NONE, 2,
+                                   G_TYPE_UINT,
+                                   G_TYPE_POINTER);
 
   object_class->constructor = hd_status_area_constructor;
   object_class->dispose = hd_status_area_dispose;
@@ -775,3 +1488,42 @@ hd_status_area_new (HDPluginManager *plugin_manager)
 
   return status_area;
 }
+
+/**
+ * hd_status_area_dump_redraws:
+ * @status_area: a #HDStatusArea
+ * @file: where to write the statistics
+ *
+ * Writes the icon redraws and their rate per minute for every display
+ * state since the status area was created.
+ **/
+void
+hd_status_area_dump_redraws (HDStatusArea *status_area,
+                             FILE         *file)
+{
+  HDStatusAreaPrivate *priv;
+  gint64 now;
+  guint i;
+
+  g_return_if_fail (HD_IS_STATUS_AREA (status_area));
+
+  priv = status_area->priv;
+  now = hd_time_get_monotonic_ms ();
+
+  fprintf (file, "%-24s %8s %10s %10s\n",
+           "display", "redraws", "seconds", "per_minute");
+
+  for (i = 0; i < HD_DISPLAY_N_STATES; i++)
+    {
+      gint64 ms = priv->display_state_ms[i];
+
+      if (i == priv->display_state)
+        ms += now - priv->display_state_since;
+
+      fprintf (file, "%-24s %8u %10.1f %10.1f\n",
+               display_state_names[i],
+               priv->redraws[i],
+               ms / 1000.0,
+               ms > 0 ? priv->redraws[i] * 60000.0 / ms : 0.0);
+    }
+}
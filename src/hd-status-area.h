@@ -27,6 +27,8 @@
 #include <gtk/gtk.h>
 #include <libhildondesktop/libhildondesktop.h>
 
+#include <stdio.h>
+
 G_BEGIN_DECLS
 
 #define HD_TYPE_STATUS_AREA             (hd_status_area_get_type ())
@@ -40,6 +42,86 @@ typedef struct _HDStatusArea        HDStatusArea;
 typedef struct _HDStatusAreaClass   HDStatusAreaClass;
 typedef struct _HDStatusAreaPrivate HDStatusAreaPrivate;
 
+/**
+ * HDStatusAreaVisibilityReasons:
+ * @HD_STATUS_AREA_VISIBILITY_DISPLAY_OFF: the display is off, plugins
+ *   should stop all updates which are only needed for the icon
+ * @HD_STATUS_AREA_VISIBILITY_DISPLAY_DIMMED: the display is dimmed, the
+ *   status area is still visible but updated at a lower rate
+ * @HD_STATUS_AREA_VISIBILITY_TASK_SWITCHER: the status area is covered by
+ *   the task switcher, cheap state should be kept up to date but nothing
+ *   needs to be rendered
+ * @HD_STATUS_AREA_VISIBILITY_OFF_SCREEN: the status area was moved off
+ *   screen, e.g. by a fullscreen application
+ *
+ * Why the status area is not (fully) visible. Status plugins get the
+ * current bitmask with the %HD_STATUS_AREA_VISIBILITY_REASONS_CHANGED_SIGNAL
+ * signal and with HD_STATUS_AREA_GET_VISIBILITY_REASONS(). 0 means the
+ * status area is visible on a display which is on. The values are
+ * stable so plugins can use them without including this header.
+ */
+typedef enum
+{
+  HD_STATUS_AREA_VISIBILITY_DISPLAY_OFF    = 1 << 0,
+  HD_STATUS_AREA_VISIBILITY_DISPLAY_DIMMED = 1 << 1,
+  HD_STATUS_AREA_VISIBILITY_TASK_SWITCHER  = 1 << 2,
+  HD_STATUS_AREA_VISIBILITY_OFF_SCREEN     = 1 << 3
+} HDStatusAreaVisibilityReasons;
+
+/* Reasons which make status-area-visible FALSE */
+#define HD_STATUS_AREA_VISIBILITY_HIDDEN_MASK (HD_STATUS_AREA_VISIBILITY_DISPLAY_OFF | \
+                                               HD_STATUS_AREA_VISIBILITY_TASK_SWITCHER | \
+                                               HD_STATUS_AREA_VISIBILITY_OFF_SCREEN)
+
+#define HD_STATUS_AREA_VISIBILITY_REASONS_KEY "status-area-visibility-reasons"
+
+/* Current HDStatusAreaVisibilityReasons bitmask of a status plugin, set
+ * when the status area adds the plugin and kept up to date */
+#define HD_STATUS_AREA_GET_VISIBILITY_REASONS(plugin) \
+  (GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (plugin), HD_STATUS_AREA_VISIBILITY_REASONS_KEY)))
+
+/* Emitted on a status plugin with the new HDStatusAreaVisibilityReasons
+ * bitmask as a guint:
+ *
+ *   void (* handler) (HDStatusPluginItem *plugin, guint reasons, gpointer data);
+ *
+ * libhildondesktop creates the plugins, so the signal is added to
+ * HDStatusPluginItem by the status area. Its type is initialized before
+ * any plugin is loaded, plugins can connect by name from their
+ * constructor on. */
+#define HD_STATUS_AREA_VISIBILITY_REASONS_CHANGED_SIGNAL "status-area-visibility-reasons-changed"
+
+/* Status plugins show an animated icon by emitting this action signal
+ * with the frame interval in milliseconds as a guint and a GList of
+ * GdkPixbuf frames, which the status area references:
+ *
+ *   void (* handler) (HDStatusPluginItem *plugin, guint interval,
+ *                     GList *frames, gpointer data);
+ *
+ * The frames are copied to the X server once and the status area flips
+ * between them, which is much cheaper than changing the
+ * status-area-icon property for every frame. Frames are not drawn while
+ * the status area is not visible. An interval of 0 or no frames goes
+ * back to the status-area-icon.
+ *
+ * Like %HD_STATUS_AREA_VISIBILITY_REASONS_CHANGED_SIGNAL the signal is
+ * added to HDStatusPluginItem by the status area, before any plugin is
+ * loaded. Without a status area, e.g. in another host, emitting it
+ * fails with a warning, so plugins should use
+ * HD_STATUS_AREA_START_ANIMATION() and HD_STATUS_AREA_STOP_ANIMATION(),
+ * which check for the signal first. */
+#define HD_STATUS_AREA_ANIMATION_SIGNAL "status-area-animation"
+
+#define HD_STATUS_AREA_START_ANIMATION(plugin, interval, frames)                      \
+  G_STMT_START {                                                                      \
+    if (g_signal_lookup (HD_STATUS_AREA_ANIMATION_SIGNAL, G_OBJECT_TYPE (plugin)))    \
+      g_signal_emit_by_name ((plugin), HD_STATUS_AREA_ANIMATION_SIGNAL,               \
+                             (guint) (interval), (GList *) (frames));                 \
+  } G_STMT_END
+
+#define HD_STATUS_AREA_STOP_ANIMATION(plugin) \
+  HD_STATUS_AREA_START_ANIMATION ((plugin), 0, NULL)
+
 struct _HDStatusArea
 {
   GtkWindow parent_instance;
@@ -53,9 +135,12 @@ struct _HDStatusAreaClass
 };
 
 
-GType      hd_status_area_get_type (void) G_GNUC_CONST;
+GType      hd_status_area_get_type     (void) G_GNUC_CONST;
+
+GtkWidget *hd_status_area_new          (HDPluginManager *plugin_manager);
 
-GtkWidget *hd_status_area_new      (HDPluginManager *plugin_manager);
+void       hd_status_area_dump_redraws (HDStatusArea    *status_area,
+                                        FILE            *file);
 
 G_END_DECLS
 
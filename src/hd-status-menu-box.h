@@ -59,6 +59,8 @@ void       hd_status_menu_box_pack          (HDStatusMenuBox *box,
 void       hd_status_menu_box_reorder_child (HDStatusMenuBox *box,
                                              GtkWidget       *child,
                                              guint            position);
+void       hd_status_menu_box_reorder_children (HDStatusMenuBox *box,
+                                                GHashTable      *positions);
 G_END_DECLS
 
 #endif /* __HD_STATUS_MENU_BOX_H__ */
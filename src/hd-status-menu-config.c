@@ -0,0 +1,266 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hd-probes.h"
+#include "hd-status-menu-config.h"
+
+/* The plugin configuration parsed once per load, shared by the
+ * status area, the status menu and the load priority function */
+static GHashTable *records = NULL;
+
+/* Plugin ids whose record changed with the last load */
+static GSList *changed = NULL;
+
+static const HDStatusMenuConfigRecord default_record =
+{
+  HD_STATUS_AREA_SLOT_NONE,
+  G_MAXUINT,
+  G_MAXUINT,
+  0,
+  0,
+  0,
+  FALSE
+};
+
+static void
+record_free (HDStatusMenuConfigRecord *record)
+{
+  g_slice_free (HDStatusMenuConfigRecord, record);
+}
+
+static guint
+get_uint (GKeyFile    *keyfile,
+          const gchar *plugin_id,
+          const gchar *key,
+          guint        default_value)
+{
+  gchar *value, *end;
+  gulong result;
+
+  value = g_key_file_get_value (keyfile, plugin_id, key, NULL);
+  if (!value)
+    return default_value;
+
+  /* Like g_key_file_get_integer (), trailing garbage is an error, and
+   * negative values are out of range */
+  errno = 0;
+  result = strtoul (value, &end, 10);
+  if (end == value || *end != '\0' || strchr (value, '-') ||
+      errno == ERANGE || result > G_MAXUINT)
+    result = default_value;
+
+  g_free (value);
+
+  return result;
+}
+
+static HDStatusAreaSlot
+parse_slot (const gchar *permanent_item)
+{
+  const gsize prefix_len = strlen (HD_STATUS_AREA_CONFIG_VALUE_SPECIAL_ITEM);
+
+  if (strcmp (permanent_item, HD_STATUS_AREA_CONFIG_VALUE_CLOCK) == 0)
+    return HD_STATUS_AREA_SLOT_CLOCK;
+
+  if (strncmp (permanent_item, HD_STATUS_AREA_CONFIG_VALUE_SPECIAL_ITEM, prefix_len) == 0)
+    {
+      const gchar *index = permanent_item + prefix_len;
+      gchar *end;
+      guint i;
+
+      i = (guint) strtoul (index, &end, 10);
+      if (end != index && *end == '\0' && i < HD_STATUS_AREA_NUM_SPECIAL_ITEMS)
+        return HD_STATUS_AREA_SLOT_SPECIAL_ITEM + i;
+    }
+
+  return HD_STATUS_AREA_SLOT_NONE;
+}
+
+static gboolean
+record_equal (const HDStatusMenuConfigRecord *a,
+              const HDStatusMenuConfigRecord *b)
+{
+  return a->slot == b->slot &&
+         a->area_position == b->area_position &&
+         a->menu_position == b->menu_position &&
+         a->icon_rate_limit == b->icon_rate_limit &&
+         a->max_cpu == b->max_cpu &&
+         a->max_icon_rate == b->max_icon_rate &&
+         a->permanent == b->permanent;
+}
+
+/**
+ * hd_status_menu_config_load:
+ * @keyfile: the plugin configuration
+ *
+ * Parses the configuration of all plugins in one pass and replaces the
+ * records of the previous load. The plugin ids whose record differs from
+ * the previous load are available with hd_status_menu_config_get_changed().
+ **/
+void
+hd_status_menu_config_load (GKeyFile *keyfile)
+{
+  GHashTable *new_records;
+  gchar **groups;
+  gsize i, n_groups;
+
+  g_return_if_fail (keyfile != NULL);
+
+  new_records = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                       (GDestroyNotify) g_free,
+                                       (GDestroyNotify) record_free);
+
+  g_slist_foreach (changed, (GFunc) g_free, NULL);
+  g_slist_free (changed);
+  changed = NULL;
+
+  groups = g_key_file_get_groups (keyfile, &n_groups);
+  for (i = 0; i < n_groups; i++)
+    {
+      HDStatusMenuConfigRecord *record, *old_record;
+      gchar *permanent_item;
+
+      record = g_slice_new (HDStatusMenuConfigRecord);
+      *record = default_record;
+
+      permanent_item = g_key_file_get_string (keyfile,
+                                              groups[i],
+                                              HD_STATUS_AREA_CONFIG_KEY_PERMANENT_ITEM,
+                                              NULL);
+      if (permanent_item)
+        {
+          record->permanent = TRUE;
+          record->slot = parse_slot (permanent_item);
+          g_free (permanent_item);
+        }
+
+      /* Use G_MAXUINT as default position */
+      record->area_position = get_uint (keyfile,
+                                        groups[i],
+                                        HD_STATUS_AREA_CONFIG_KEY_POSITION,
+                                        G_MAXUINT);
+      record->menu_position = get_uint (keyfile,
+                                        groups[i],
+                                        HD_STATUS_MENU_CONFIG_KEY_POSITION,
+                                        G_MAXUINT);
+
+      record->icon_rate_limit = get_uint (keyfile,
+                                          groups[i],
+                                          HD_STATUS_AREA_CONFIG_KEY_ICON_RATE,
+                                          0);
+
+      record->max_cpu = get_uint (keyfile,
+                                  groups[i],
+                                  HD_STATUS_MENU_CONFIG_KEY_MAX_CPU,
+                                  0);
+      record->max_icon_rate = get_uint (keyfile,
+                                        groups[i],
+                                        HD_STATUS_MENU_CONFIG_KEY_MAX_ICON_RATE,
+                                        0);
+
+      if (records)
+        {
+          old_record = g_hash_table_lookup (records, groups[i]);
+
+          if (!old_record || !record_equal (old_record, record))
+            changed = g_slist_prepend (changed, g_strdup (groups[i]));
+
+          g_hash_table_remove (records, groups[i]);
+        }
+
+      /* Takes the group name */
+      g_hash_table_insert (new_records, groups[i], record);
+    }
+  /* Group names are owned by new_records now */
+  g_free (groups);
+
+  /* Plugins left over were removed from the configuration */
+  if (records)
+    {
+      GHashTableIter iter;
+      gpointer key;
+
+      g_hash_table_iter_init (&iter, records);
+      while (g_hash_table_iter_next (&iter, &key, NULL))
+        changed = g_slist_prepend (changed, g_strdup (key));
+
+      g_hash_table_destroy (records);
+    }
+
+  records = new_records;
+
+  HD_PROBE1 (config__reload, g_hash_table_size (records));
+}
+
+/**
+ * hd_status_menu_config_lookup:
+ * @plugin_id: the plugin id
+ *
+ * Returns: the configuration record of @plugin_id from the last
+ * hd_status_menu_config_load(). Plugins without configuration, or
+ * looked up before the first load, get a default record. The record is
+ * owned by the configuration and valid until the next load.
+ **/
+const HDStatusMenuConfigRecord *
+hd_status_menu_config_lookup (const gchar *plugin_id)
+{
+  const HDStatusMenuConfigRecord *record;
+
+  record = records ? g_hash_table_lookup (records, plugin_id) : NULL;
+
+  return record ? record : &default_record;
+}
+
+/**
+ * hd_status_menu_config_get_changed:
+ *
+ * Returns: the list of plugin ids whose record was added, changed or
+ * removed with the last hd_status_menu_config_load().
+ **/
+const GSList *
+hd_status_menu_config_get_changed (void)
+{
+  return changed;
+}
+
+/**
+ * hd_status_menu_config_is_menu_only:
+ * @record: a configuration record
+ *
+ * Returns: %TRUE if the plugin of @record has a status menu position
+ * but no status area icon, i.e. it is only needed in the menu
+ **/
+gboolean
+hd_status_menu_config_is_menu_only (const HDStatusMenuConfigRecord *record)
+{
+  return !record->permanent &&
+         record->slot == HD_STATUS_AREA_SLOT_NONE &&
+         record->area_position == G_MAXUINT &&
+         record->menu_position != G_MAXUINT;
+}
@@ -22,13 +22,60 @@
 #ifndef __HD_STATUS_MENU_CONFIG_H__
 #define __HD_STATUS_MENU_CONFIG_H__
 
+#include <glib.h>
+
+G_BEGIN_DECLS
+
 #define HD_STATUS_AREA_CONFIG_KEY_POSITION       "X-Status-Area-Position"
 #define HD_STATUS_AREA_CONFIG_KEY_PERMANENT_ITEM "X-Status-Area-Permanent-Item"
+#define HD_STATUS_AREA_CONFIG_KEY_ICON_RATE      "X-Status-Area-Icon-Rate-Limit"
 #define HD_STATUS_AREA_CONFIG_VALUE_CLOCK        "Clock"
-#define HD_STATUS_AREA_CONFIG_VALUE_SPECIAL_ITEM "Special-Item-%u"
+#define HD_STATUS_AREA_CONFIG_VALUE_SPECIAL_ITEM "Special-Item-"
 
 #define HD_STATUS_AREA_NUM_SPECIAL_ITEMS         2
 
 #define HD_STATUS_MENU_CONFIG_KEY_POSITION       "X-Status-Menu-Position"
 
+/* Quotas, main loop CPU ms per second and icon updates per second */
+#define HD_STATUS_MENU_CONFIG_KEY_MAX_CPU        "X-Status-Max-Cpu"
+#define HD_STATUS_MENU_CONFIG_KEY_MAX_ICON_RATE  "X-Status-Max-Icon-Rate"
+
+/* Where a plugin is shown in the status area */
+typedef enum
+{
+  HD_STATUS_AREA_SLOT_NONE,
+  HD_STATUS_AREA_SLOT_CLOCK,
+  HD_STATUS_AREA_SLOT_SPECIAL_ITEM
+  /* HD_STATUS_AREA_SLOT_SPECIAL_ITEM + i for the i-th special item */
+} HDStatusAreaSlot;
+
+typedef struct _HDStatusMenuConfigRecord HDStatusMenuConfigRecord;
+
+/* Parsed configuration of a plugin from status-menu.plugins */
+struct _HDStatusMenuConfigRecord
+{
+  HDStatusAreaSlot slot;
+  guint            area_position;
+  guint            menu_position;
+
+  /* maximum icon redraws per second, 0 if unlimited */
+  guint            icon_rate_limit;
+
+  /* 0 if unlimited */
+  guint            max_cpu;
+  guint            max_icon_rate;
+
+  guint            permanent : 1;
+};
+
+void                            hd_status_menu_config_load         (GKeyFile                       *keyfile);
+
+const HDStatusMenuConfigRecord *hd_status_menu_config_lookup       (const gchar                    *plugin_id);
+
+const GSList                   *hd_status_menu_config_get_changed  (void);
+
+gboolean                        hd_status_menu_config_is_menu_only (const HDStatusMenuConfigRecord *record);
+
+G_END_DECLS
+
 #endif
@@ -40,7 +40,14 @@
 
 #include "hd-status-menu.h"
 #include "hd-status-menu-box.h"
+#include "hd-flight-recorder.h"
+#include "hd-memory-pressure.h"
+#include "hd-metrics.h"
+#include "hd-plugin-stats.h"
+#include "hd-probes.h"
 #include "hd-status-menu-config.h"
+#include "hd-system-bus.h"
+#include "hd-x-stats.h"
 
 /**
  * SECTION:hdstatusmenu
@@ -64,6 +71,10 @@
 #define DSME_SIGNAL_INTERFACE "com.nokia.dsme.signal"
 #define DSME_SHUTDOWN_SIGNAL_NAME "shutdown_ind"
 
+/* Menu only plugins are packed when the menu is shown first or after
+ * this many seconds of idle time */
+#define DEFERRED_PLUGINS_PREWARM_DELAY 60
+
 #define NUMBER_OF_ROWS_GCONF_DIR "/apps/osso/hildon-status-menu/view"
 #define NUMBER_OF_ROWS_GCONF_KEY NUMBER_OF_ROWS_GCONF_DIR "/number_of_rows"
 #define NUMBER_OF_ROWS_PORTRAIT_GCONF_KEY NUMBER_OF_ROWS_GCONF_DIR "/number_of_rows_portrait"
@@ -84,15 +95,37 @@ struct _HDStatusMenuPrivate
 
   HDPluginManager *plugin_manager;
 
+  /* plugin id -> HDStatusMenuItem with its applied position */
+  GHashTable      *items;
+
+  /* menu only plugins not packed yet, and the idle pre-warm */
+  GList           *deferred_plugins;
+  guint            prewarm_id;
+  gboolean         defer_plugins;
+
   GConfClient     *gconf_client;
 
+  HDSystemBus     *system_bus;
+  guint            shutdown_signal_id;
+
+  HDMemoryPressure *memory_pressure;
+
   gboolean         pressed_outside;
 
   gboolean         portrait;
+
+  /* no expose since the last map */
+  gboolean         first_expose;
+
+  /* start of the menu open, 0 once it is drawn */
+  gint64           show_start;
 };
 
 #define HD_STATUS_MENU_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), HD_TYPE_STATUS_MENU, HDStatusMenuPrivate));
 
+static GQuark      quark_hd_status_menu_position = 0;
+static const gchar hd_status_menu_position[] = "hd_status_menu_position";
+
 G_DEFINE_TYPE (HDStatusMenu, hd_status_menu, GTK_TYPE_WINDOW);
 
 static void
@@ -141,20 +174,14 @@ notify_visible_items_cb (HDStatusMenu *status_menu)
     }
 }
 
-static DBusHandlerResult
-hd_status_menu_dbus_handler (DBusConnection *conn,
-                             DBusMessage *msg, void *data)
+static void
+hd_status_menu_shutdown_cb (DBusMessage *msg,
+                            gpointer     data)
 {
-  if (dbus_message_is_signal(msg, DSME_SIGNAL_INTERFACE,
-                             DSME_SHUTDOWN_SIGNAL_NAME))
-    {
-            /*
-      g_warning ("%s: " DSME_SHUTDOWN_SIGNAL_NAME " from DSME", __func__);
-      */
-      exit (0);
-    }
-
-  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+  /*
+  g_warning ("%s: " DSME_SHUTDOWN_SIGNAL_NAME " from DSME", __func__);
+  */
+  exit (0);
 }
 
 static void
@@ -206,34 +233,44 @@ hd_status_menu_on_gconf_value_changed (GConfClient *client G_GNUC_UNUSED,
     }
 }
 
+/* The hidden menu keeps its X windows and backing pixmaps, they are
+ * created again when it is shown */
+static void
+hd_status_menu_memory_trim_cb (HDMemoryPressure *memory_pressure,
+                               HDStatusMenu     *status_menu)
+{
+  GtkWidget *widget = GTK_WIDGET (status_menu);
+
+  if (GTK_WIDGET_REALIZED (widget) && !GTK_WIDGET_VISIBLE (widget))
+    gtk_widget_unrealize (widget);
+}
+
 static void
 hd_status_menu_init (HDStatusMenu *status_menu)
 {
-  DBusConnection *sysbus;
-  DBusError derror;
   HDStatusMenuPrivate *priv = HD_STATUS_MENU_GET_PRIVATE (status_menu);
   GtkWidget *alignment; /* Used to center the pannable */
 
   /* Set priv member */
   status_menu->priv = priv;
 
-  /* connect to D-Bus system bus */
-  dbus_error_init (&derror);
-  sysbus = dbus_bus_get (DBUS_BUS_SYSTEM, &derror);
-  if (!sysbus)
-    {
-      dbus_error_free (&derror);
-      g_warning ("%s: failed to connect to the system bus", __func__);
-    }
-  else
-    {
-      /* listen to shutdown_ind from DSME */
-      dbus_bus_add_match (sysbus, "type='signal', interface='"
-                          DSME_SIGNAL_INTERFACE "'", NULL);
+  /* listen to shutdown_ind from DSME */
+  priv->system_bus = hd_system_bus_get ();
+  priv->shutdown_signal_id = hd_system_bus_add_signal_handler (priv->system_bus,
+                                                               DSME_SIGNAL_INTERFACE,
+                                                               DSME_SHUTDOWN_SIGNAL_NAME,
+                                                               hd_status_menu_shutdown_cb,
+                                                               status_menu);
 
-      dbus_connection_add_filter (sysbus, hd_status_menu_dbus_handler,
-                                  NULL, NULL);
-    }
+  priv->items = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                       (GDestroyNotify) g_free,
+                                       NULL);
+
+  priv->memory_pressure = hd_memory_pressure_get ();
+  g_signal_connect (priv->memory_pressure, "trim",
+                    G_CALLBACK (hd_status_menu_memory_trim_cb), status_menu);
+
+  priv->defer_plugins = g_getenv (HD_STATUS_MENU_EAGER_PLUGINS_ENV) == NULL;
 
   /* Initialize GConfClient */
   priv->gconf_client = gconf_client_get_default ();
@@ -301,39 +338,147 @@ hd_status_menu_dispose (GObject *object)
       priv->gconf_client = NULL;
     }
 
+  if (priv->system_bus)
+    {
+      if (priv->shutdown_signal_id)
+        hd_system_bus_remove_signal_handler (priv->system_bus,
+                                             priv->shutdown_signal_id);
+      priv->shutdown_signal_id = 0;
+
+      g_object_unref (priv->system_bus);
+      priv->system_bus = NULL;
+    }
+
+  if (priv->memory_pressure)
+    {
+      g_signal_handlers_disconnect_by_func (priv->memory_pressure,
+                                            hd_status_menu_memory_trim_cb,
+                                            object);
+      g_object_unref (priv->memory_pressure);
+      priv->memory_pressure = NULL;
+    }
+
+  if (priv->items)
+    {
+      g_hash_table_destroy (priv->items);
+      priv->items = NULL;
+    }
+
+  if (priv->prewarm_id)
+    {
+      g_source_remove (priv->prewarm_id);
+      priv->prewarm_id = 0;
+    }
+
+  g_list_foreach (priv->deferred_plugins, (GFunc) gtk_widget_destroy, NULL);
+  g_list_foreach (priv->deferred_plugins, (GFunc) g_object_unref, NULL);
+  g_list_free (priv->deferred_plugins);
+  priv->deferred_plugins = NULL;
+
   G_OBJECT_CLASS (hd_status_menu_parent_class)->dispose (object);
 }
 
+static void
+plugin_notify_visible_cb (GObject    *plugin,
+                          GParamSpec *pspec,
+                          gpointer    data)
+{
+  HDPluginStats *stats = hd_plugin_stats_lookup (plugin);
+
+  /* Showing or hiding an item resizes the status menu */
+  if (stats)
+    stats->resizes++;
+}
+
+/* Packs the plugins which were kept out of the menu until now */
+static void
+pack_deferred_plugins (HDStatusMenu *status_menu)
+{
+  HDStatusMenuPrivate *priv = status_menu->priv;
+  GList *plugins, *p;
+
+  /* Plugins added from now on are packed right away */
+  priv->defer_plugins = FALSE;
+
+  if (priv->prewarm_id)
+    {
+      g_source_remove (priv->prewarm_id);
+      priv->prewarm_id = 0;
+    }
+
+  if (!priv->deferred_plugins)
+    return;
+
+  plugins = g_list_reverse (priv->deferred_plugins);
+  priv->deferred_plugins = NULL;
+
+  for (p = plugins; p; p = p->next)
+    {
+      guint position;
+
+      position = GPOINTER_TO_UINT (g_object_get_qdata (p->data,
+                                                       quark_hd_status_menu_position));
+      hd_status_menu_box_pack (HD_STATUS_MENU_BOX (priv->box),
+                               GTK_WIDGET (p->data),
+                               position);
+      g_object_unref (p->data);
+    }
+
+  g_list_free (plugins);
+}
+
+static gboolean
+prewarm_cb (HDStatusMenu *status_menu)
+{
+  status_menu->priv->prewarm_id = 0;
+
+  pack_deferred_plugins (status_menu);
+
+  return FALSE;
+}
+
 static void
 hd_status_menu_plugin_added_cb (HDPluginManager *plugin_manager,
                                 GObject         *plugin,
                                 HDStatusMenu    *status_menu)
 {
   HDStatusMenuPrivate *priv = status_menu->priv;
+  const HDStatusMenuConfigRecord *record;
   gchar *plugin_id;
-  GKeyFile *keyfile;
   guint position;
-  GError *error = NULL;
 
   /* Plugin must be a HDStatusMenuItem */
   if (!HD_IS_STATUS_MENU_ITEM (plugin))
     return;
 
   /* Read position in Status Menu from plugin configuration */
-  keyfile = hd_plugin_manager_get_plugin_config_key_file (plugin_manager);
   plugin_id = hd_plugin_item_get_plugin_id (HD_PLUGIN_ITEM (plugin));
 
-  position = (guint) g_key_file_get_integer (keyfile,
-                                             plugin_id,
-                                             HD_STATUS_MENU_CONFIG_KEY_POSITION,
-                                             &error);
-  g_free (plugin_id);
+  record = hd_status_menu_config_lookup (plugin_id);
+  position = record->menu_position;
+
+  /* Remember the applied position to handle configuration reloads as a diff */
+  g_object_set_qdata (plugin, quark_hd_status_menu_position,
+                      GUINT_TO_POINTER (position));
+  g_hash_table_insert (priv->items, plugin_id, plugin);
 
-  /* Use G_MAXUINT as default position */
-  if (error)
+  g_signal_connect (plugin, "notify::visible",
+                    G_CALLBACK (plugin_notify_visible_cb), NULL);
+
+  /* Menu only plugins are not sized and styled until the menu is
+   * needed, their widgets are kept alive until then */
+  if (priv->defer_plugins && hd_status_menu_config_is_menu_only (record))
     {
-      g_error_free (error);
-      position = G_MAXUINT;
+      priv->deferred_plugins = g_list_prepend (priv->deferred_plugins,
+                                               g_object_ref_sink (plugin));
+
+      if (!priv->prewarm_id)
+        priv->prewarm_id = g_timeout_add_seconds_full (G_PRIORITY_LOW,
+                                                       DEFERRED_PLUGINS_PREWARM_DELAY,
+                                                       (GSourceFunc) prewarm_cb,
+                                                       status_menu,
+                                                       NULL);
+      return;
     }
 
   /* Pack the plugin into the box. The plugin is responsible to show 
@@ -348,43 +493,31 @@ hd_status_menu_plugin_removed_cb (HDPluginManager *plugin_manager,
                                   HDStatusMenu    *status_menu)
 {
   HDStatusMenuPrivate *priv = status_menu->priv;
+  gchar *plugin_id;
 
   /* Plugin must be a HDStatusMenuItem */
   if (!HD_IS_STATUS_MENU_ITEM (plugin))
     return;
 
-  /* Remove the plugin from the container (and destroy it) */
-  gtk_container_remove (GTK_CONTAINER (priv->box), GTK_WIDGET (plugin));
-}
-
-static void
-update_position (GtkWidget *child,
-                 GKeyFile  *keyfile)
-{
-  gchar *plugin_id;
-  guint position;
-  GError *error = NULL;
-
-  plugin_id = hd_plugin_item_get_plugin_id (HD_PLUGIN_ITEM (child));
-
-  /* Get the position from the plugin configuration file */
-  position = (guint) g_key_file_get_integer (keyfile,
-                                             plugin_id,
-                                             HD_STATUS_MENU_CONFIG_KEY_POSITION,
-                                             &error);
+  plugin_id = hd_plugin_item_get_plugin_id (HD_PLUGIN_ITEM (plugin));
+  g_hash_table_remove (priv->items, plugin_id);
   g_free (plugin_id);
 
-  /* Use G_MAXUINT as default */
-  if (error)
+  g_signal_handlers_disconnect_by_func (plugin,
+                                        plugin_notify_visible_cb,
+                                        NULL);
+
+  /* Not packed yet, drop the reference kept instead of the box */
+  if (g_list_find (priv->deferred_plugins, plugin))
     {
-      g_error_free (error);
-      position = G_MAXUINT;
+      priv->deferred_plugins = g_list_remove (priv->deferred_plugins, plugin);
+      gtk_widget_destroy (GTK_WIDGET (plugin));
+      g_object_unref (plugin);
+      return;
     }
 
-  /* Reorder Child */
-  hd_status_menu_box_reorder_child (HD_STATUS_MENU_BOX (gtk_widget_get_parent (child)),
-                                    child,
-                                    position);
+  /* Remove the plugin from the container (and destroy it) */
+  gtk_container_remove (GTK_CONTAINER (priv->box), GTK_WIDGET (plugin));
 }
 
 static void
@@ -393,8 +526,44 @@ hd_status_menu_items_configuration_loaded_cb (HDPluginManager *plugin_manager,
                                                HDStatusMenu    *status_menu)
 {
   HDStatusMenuPrivate *priv = status_menu->priv;
+  const GSList *c;
+  GHashTable *positions = NULL;
+
+  /* Only touch items whose configuration changed with this load */
+  for (c = hd_status_menu_config_get_changed (); c; c = c->next)
+    {
+      gpointer value;
+      guint position;
+
+      value = g_hash_table_lookup (priv->items, c->data);
+      if (!value)
+        continue;
+
+      position = hd_status_menu_config_lookup (c->data)->menu_position;
+
+      if (position == GPOINTER_TO_UINT (g_object_get_qdata (value,
+                                                             quark_hd_status_menu_position)))
+        continue;
+
+      g_object_set_qdata (value, quark_hd_status_menu_position,
+                          GUINT_TO_POINTER (position));
 
-  gtk_container_foreach (GTK_CONTAINER (priv->box), (GtkCallback) update_position, key_file);
+      /* Deferred plugins are packed at the new position later */
+      if (g_list_find (priv->deferred_plugins, value))
+        continue;
+
+      if (!positions)
+        positions = g_hash_table_new (g_direct_hash, g_direct_equal);
+      g_hash_table_insert (positions, value, GUINT_TO_POINTER (position));
+    }
+
+  /* Apply all moves with a single reorder */
+  if (positions)
+    {
+      hd_status_menu_box_reorder_children (HD_STATUS_MENU_BOX (priv->box),
+                                           positions);
+      g_hash_table_destroy (positions);
+    }
 }
 
 static void
@@ -473,6 +642,7 @@ hd_status_menu_realize (GtkWidget *widget)
   GdkScreen *screen;
   GdkDisplay *display;
   Atom atom, wm_type;
+  HDXStatsSection section;
 
   screen = gtk_widget_get_screen (widget);
   g_signal_connect_swapped (screen, "size-changed",
@@ -487,10 +657,12 @@ hd_status_menu_realize (GtkWidget *widget)
 
   /* Set the _NET_WM_WINDOW_TYPE property to _HILDON_WM_WINDOW_TYPE_STATUS_MENU */
   display = gdk_drawable_get_display (widget->window);
+  hd_x_stats_begin (&section);
   atom = gdk_x11_get_xatom_by_name_for_display (display,
                                                 "_NET_WM_WINDOW_TYPE");
   wm_type = gdk_x11_get_xatom_by_name_for_display (display,
                                                    "_HILDON_WM_WINDOW_TYPE_STATUS_MENU");
+  hd_x_stats_end (&section, "status-menu:realize-atoms");
 
   XChangeProperty (GDK_WINDOW_XDISPLAY (widget->window),
                    GDK_WINDOW_XID (widget->window),
@@ -511,18 +683,66 @@ hd_status_menu_unrealize (GtkWidget *widget)
   GTK_WIDGET_CLASS (hd_status_menu_parent_class)->unrealize (widget);
 }
 
+static void
+hd_status_menu_show (GtkWidget *widget)
+{
+  HD_PROBE0 (menu__show);
+
+  HD_STATUS_MENU (widget)->priv->show_start = hd_metrics_begin ();
+
+  /* All items must be in the box before the menu is sized */
+  pack_deferred_plugins (HD_STATUS_MENU (widget));
+
+  GTK_WIDGET_CLASS (hd_status_menu_parent_class)->show (widget);
+}
+
 static void
 hd_status_menu_map (GtkWidget *widget)
 {
+  HD_PROBE0 (menu__map);
+
+  HD_STATUS_MENU (widget)->priv->first_expose = TRUE;
+
   GTK_WIDGET_CLASS (hd_status_menu_parent_class)->map (widget);
   update_portrait (HD_STATUS_MENU (widget));
 }
 
+static gboolean
+hd_status_menu_expose_event (GtkWidget      *widget,
+                             GdkEventExpose *event)
+{
+  HDStatusMenuPrivate *priv = HD_STATUS_MENU (widget)->priv;
+  gboolean result;
+
+  result = GTK_WIDGET_CLASS (hd_status_menu_parent_class)->expose_event (widget, event);
+
+  /* After drawing, the end of the time to visible */
+  if (priv->first_expose)
+    {
+      priv->first_expose = FALSE;
+      HD_PROBE0 (menu__first__expose);
+
+      if (priv->show_start)
+        {
+          HD_METRICS_END ("menu-open", priv->show_start);
+          priv->show_start = 0;
+        }
+    }
+
+  return result;
+}
+
 static void
 hd_status_menu_check_resize (GtkContainer *container)
 {
   GtkWindow *window = GTK_WINDOW (container);
   GtkWidget *widget = GTK_WIDGET (container);
+  HDXStatsSection section;
+  gint64 start = hd_flight_recorder_begin ();
+  gint64 layout_start = hd_metrics_begin ();
+
+  /* bitfield, sizeof can not be applied */
+  HD_PROBE1 (menu__check__resize, (gint) window->configure_notify_received);
 
   /* Handle a resize based on a configure notify event
    *
@@ -539,7 +759,9 @@ hd_status_menu_check_resize (GtkContainer *container)
       allocation = widget->allocation;
       gtk_widget_size_allocate (widget, &allocation);
 
+      hd_x_stats_begin (&section);
       gdk_window_process_updates (widget->window, TRUE);
+      hd_x_stats_end (&section, "status-menu:check-resize-updates");
       
       gdk_window_configure_finished (widget->window);
 
@@ -548,6 +770,9 @@ hd_status_menu_check_resize (GtkContainer *container)
        */
       gtk_widget_queue_resize (widget);
 
+      hd_flight_recorder_end (HD_FLIGHT_EVENT_LAYOUT, start, 1, "status-menu");
+      HD_METRICS_END ("status-menu-layout", layout_start);
+
       return;
     }
 
@@ -566,6 +791,9 @@ hd_status_menu_check_resize (GtkContainer *container)
       /* Resize children (also if size not changed and so no
        * configure notify event is triggered) */
       gtk_container_resize_children (GTK_CONTAINER (widget));
+
+      hd_flight_recorder_end (HD_FLIGHT_EVENT_LAYOUT, start, 0, "status-menu");
+      HD_METRICS_END ("status-menu-layout", layout_start);
     }
 }
 
@@ -576,12 +804,16 @@ hd_status_menu_class_init (HDStatusMenuClass *klass)
   GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
   GtkContainerClass *container_class = GTK_CONTAINER_CLASS (klass);
 
+  quark_hd_status_menu_position = g_quark_from_static_string (hd_status_menu_position);
+
   object_class->dispose = hd_status_menu_dispose;
   object_class->set_property = hd_status_menu_set_property;
 
   widget_class->realize = hd_status_menu_realize;
   widget_class->unrealize = hd_status_menu_unrealize;
+  widget_class->show = hd_status_menu_show;
   widget_class->map = hd_status_menu_map;
+  widget_class->expose_event = hd_status_menu_expose_event;
 
   container_class->check_resize = hd_status_menu_check_resize;
 
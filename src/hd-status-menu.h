@@ -36,6 +36,10 @@ G_BEGIN_DECLS
 #define HD_IS_STATUS_MENU_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), HD_TYPE_STATUS_MENU))
 #define HD_STATUS_MENU_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), HD_TYPE_STATUS_MENU, HDStatusMenuClass))
 
+/* Set this environment variable to pack menu only plugins at startup
+ * instead of when the menu is first needed */
+#define HD_STATUS_MENU_EAGER_PLUGINS_ENV "HD_STATUS_MENU_EAGER_PLUGINS"
+
 /** HDStatusMenu:
  *
  * A #GtkWindow subclass which implements a Status Menu.
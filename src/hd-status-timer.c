@@ -0,0 +1,665 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/timerfd.h>
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hd-plugin-stats.h"
+#include "hd-status-timer.h"
+#include "hd-time.h"
+
+#ifndef TFD_TIMER_CANCEL_ON_SET
+#define TFD_TIMER_CANCEL_ON_SET (1 << 1)
+#endif
+
+#define HD_STATUS_TIMER_GET_PRIVATE(object) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((object), HD_TYPE_STATUS_TIMER, HDStatusTimerPrivate))
+
+/* Wakeups are moved back onto this grid when the slack allows it */
+#define TICK_ALIGNMENT 1000
+
+typedef struct _HDStatusTimerSubscription HDStatusTimerSubscription;
+struct _HDStatusTimerSubscription
+{
+  guint       id;
+  guint       period;
+  guint       slack;
+  GSourceFunc func;
+  gpointer    data;
+
+  /* earliest time of the next call */
+  gint64      due;
+
+  guint       removed : 1;
+};
+
+struct _HDStatusTimerPrivate
+{
+  GList *subscriptions;
+  guint last_id;
+
+  guint source_id;
+  gint64 deadline;
+
+  guint paused : 1;
+  guint dispatching : 1;
+
+  /* wall-clock minute ticks */
+  gint minute_fd;
+  GIOChannel *minute_channel;
+  guint minute_watch_id;
+  guint minute_timeout_id;
+};
+
+enum
+{
+  MINUTE_CHANGED,
+  ADD_TIMEOUT,
+  REMOVE_TIMEOUT,
+
+  LAST_SIGNAL
+};
+
+static guint status_timer_signals[LAST_SIGNAL] = { 0, };
+
+/* Wakeups of the whole process, counted by a source of the default
+ * main context */
+static GSource *wakeup_source = NULL;
+static guint64 wakeups = 0;
+static gint64 wakeups_since = 0;
+
+/* Wakeups per second between the last two minute ticks */
+static guint64 minute_wakeups = 0;
+static gint64 minute_wakeups_time = 0;
+static gdouble wakeup_rate = 0.0;
+
+static void hd_status_timer_dispose (GObject *object);
+
+static void schedule             (HDStatusTimer *timer);
+static void arm_minute_timer     (HDStatusTimer *timer);
+static void disarm_minute_timer  (HDStatusTimer *timer);
+
+G_DEFINE_TYPE (HDStatusTimer, hd_status_timer, G_TYPE_OBJECT);
+
+static gboolean
+wakeup_source_prepare (GSource *source,
+                       gint    *timeout)
+{
+  *timeout = -1;
+
+  return FALSE;
+}
+
+/* Called after every poll of the main loop, so each iteration is
+ * counted; only those with a source ready before the poll are not a
+ * wakeup */
+static gboolean
+wakeup_source_check (GSource *source)
+{
+  wakeups++;
+
+  return FALSE;
+}
+
+static gboolean
+wakeup_source_dispatch (GSource     *source,
+                        GSourceFunc  callback,
+                        gpointer     data)
+{
+  return TRUE;
+}
+
+static GSourceFuncs wakeup_source_funcs =
+{
+  wakeup_source_prepare,
+  wakeup_source_check,
+  wakeup_source_dispatch,
+  NULL
+};
+
+static void
+add_timeout_action (HDStatusTimer        *timer,
+                    HDStatusTimerRequest *request)
+{
+  request->id = hd_status_timer_add (timer,
+                                     request->period,
+                                     request->slack,
+                                     request->func,
+                                     request->data);
+}
+
+static void
+hd_status_timer_class_init (HDStatusTimerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = hd_status_timer_dispose;
+
+  klass->add_timeout = add_timeout_action;
+  klass->remove_timeout = hd_status_timer_remove;
+
+  status_timer_signals[MINUTE_CHANGED] = g_signal_new ("minute-changed",
+                                                       HD_TYPE_STATUS_TIMER,
+                                                       G_SIGNAL_RUN_LAST,
+                                                       0,
+                                                       NULL, NULL,
+                                                       g_cclosure_marshal_VOID__VOID,
+                                                       G_TYPE_NONE, 0);
+  status_timer_signals[ADD_TIMEOUT] = g_signal_new ("add-timeout",
+                                                    HD_TYPE_STATUS_TIMER,
+                                                    G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+                                                    G_STRUCT_OFFSET (HDStatusTimerClass, add_timeout),
+                                                    NULL, NULL,
+                                                    g_cclosure_marshal_VOID__POINTER,
+                                                    G_TYPE_NONE, 1,
+                                                    G_TYPE_POINTER);
+  status_timer_signals[REMOVE_TIMEOUT] = g_signal_new ("remove-timeout",
+                                                       HD_TYPE_STATUS_TIMER,
+                                                       G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+                                                       G_STRUCT_OFFSET (HDStatusTimerClass, remove_timeout),
+                                                       NULL, NULL,
+                                                       g_cclosure_marshal_VOID__UINT,
+                                                       G_TYPE_NONE, 1,
+                                                       G_TYPE_UINT);
+
+  g_type_class_add_private (klass, sizeof (HDStatusTimerPrivate));
+}
+
+static void
+hd_status_timer_init (HDStatusTimer *timer)
+{
+  HDStatusTimerPrivate *priv;
+
+  timer->priv = priv = HD_STATUS_TIMER_GET_PRIVATE (timer);
+
+  priv->minute_fd = -1;
+
+  /* Checked first, so no ready source hides an iteration */
+  if (!wakeup_source)
+    {
+      wakeup_source = g_source_new (&wakeup_source_funcs, sizeof (GSource));
+      g_source_set_priority (wakeup_source, G_MININT);
+      g_source_attach (wakeup_source, NULL);
+
+      wakeups_since = minute_wakeups_time = hd_time_get_monotonic_ms ();
+    }
+
+  arm_minute_timer (timer);
+}
+
+static void
+subscription_free (HDStatusTimerSubscription *sub)
+{
+  g_slice_free (HDStatusTimerSubscription, sub);
+}
+
+static void
+hd_status_timer_dispose (GObject *object)
+{
+  HDStatusTimer *timer = HD_STATUS_TIMER (object);
+  HDStatusTimerPrivate *priv = timer->priv;
+
+  if (priv->source_id)
+    {
+      g_source_remove (priv->source_id);
+      priv->source_id = 0;
+    }
+
+  disarm_minute_timer (timer);
+
+  if (priv->minute_fd != -1)
+    {
+      close (priv->minute_fd);
+      priv->minute_fd = -1;
+    }
+
+  g_list_foreach (priv->subscriptions, (GFunc) subscription_free, NULL);
+  g_list_free (priv->subscriptions);
+  priv->subscriptions = NULL;
+
+  G_OBJECT_CLASS (hd_status_timer_parent_class)->dispose (object);
+}
+
+static void
+update_wakeup_rate (void)
+{
+  gint64 now = hd_time_get_monotonic_ms ();
+
+  if (now <= minute_wakeups_time)
+    return;
+
+  wakeup_rate = (wakeups - minute_wakeups) * 1000.0 /
+                (now - minute_wakeups_time);
+  minute_wakeups = wakeups;
+  minute_wakeups_time = now;
+}
+
+static void
+emit_minute_changed (HDStatusTimer *timer)
+{
+  /* Reported on the minute tick so it does not cost extra wakeups */
+  update_wakeup_rate ();
+
+  g_signal_emit (timer, status_timer_signals[MINUTE_CHANGED], 0);
+}
+
+static gboolean
+minute_timeout_cb (HDStatusTimer *timer)
+{
+  timer->priv->minute_timeout_id = 0;
+
+  emit_minute_changed (timer);
+
+  arm_minute_timer (timer);
+
+  return FALSE;
+}
+
+static gboolean
+minute_fd_cb (GIOChannel    *source,
+              GIOCondition   condition,
+              HDStatusTimer *timer)
+{
+  HDStatusTimerPrivate *priv = timer->priv;
+  guint64 expirations;
+
+  if (read (priv->minute_fd, &expirations, sizeof (expirations)) < 0)
+    {
+      if (errno == EAGAIN)
+        return TRUE;
+
+      /* The wall clock was changed, the timer has to be armed again
+       * for the new next minute */
+      if (errno == ECANCELED)
+        {
+          emit_minute_changed (timer);
+          arm_minute_timer (timer);
+          return TRUE;
+        }
+
+      g_warning ("%s. Could not read timer. %s",
+                 __FUNCTION__,
+                 g_strerror (errno));
+      return TRUE;
+    }
+
+  emit_minute_changed (timer);
+
+  return TRUE;
+}
+
+static void
+arm_minute_timer (HDStatusTimer *timer)
+{
+  HDStatusTimerPrivate *priv = timer->priv;
+  struct itimerspec spec;
+  struct timespec now;
+
+  clock_gettime (CLOCK_REALTIME, &now);
+
+  if (priv->minute_fd == -1)
+    priv->minute_fd = timerfd_create (CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+
+  if (priv->minute_fd == -1)
+    {
+      /* Fall back to a timeout which does not notice clock changes */
+      if (!priv->minute_timeout_id)
+        priv->minute_timeout_id = g_timeout_add_seconds (60 - now.tv_sec % 60,
+                                                         (GSourceFunc) minute_timeout_cb,
+                                                         timer);
+      return;
+    }
+
+  memset (&spec, 0, sizeof (spec));
+  spec.it_value.tv_sec = now.tv_sec - now.tv_sec % 60 + 60;
+  spec.it_interval.tv_sec = 60;
+
+  if (timerfd_settime (priv->minute_fd,
+                       TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET,
+                       &spec, NULL) == -1 &&
+      timerfd_settime (priv->minute_fd,
+                       TFD_TIMER_ABSTIME,
+                       &spec, NULL) == -1)
+    g_warning ("%s. Could not arm timer. %s",
+               __FUNCTION__,
+               g_strerror (errno));
+
+  if (!priv->minute_watch_id)
+    {
+      priv->minute_channel = g_io_channel_unix_new (priv->minute_fd);
+      priv->minute_watch_id = g_io_add_watch (priv->minute_channel,
+                                              G_IO_IN,
+                                              (GIOFunc) minute_fd_cb,
+                                              timer);
+    }
+}
+
+static void
+disarm_minute_timer (HDStatusTimer *timer)
+{
+  HDStatusTimerPrivate *priv = timer->priv;
+
+  if (priv->minute_timeout_id)
+    {
+      g_source_remove (priv->minute_timeout_id);
+      priv->minute_timeout_id = 0;
+    }
+
+  if (priv->minute_watch_id)
+    {
+      struct itimerspec spec;
+
+      memset (&spec, 0, sizeof (spec));
+      timerfd_settime (priv->minute_fd, 0, &spec, NULL);
+
+      g_source_remove (priv->minute_watch_id);
+      priv->minute_watch_id = 0;
+      g_io_channel_unref (priv->minute_channel);
+      priv->minute_channel = NULL;
+    }
+}
+
+static void
+sweep_removed (HDStatusTimer *timer)
+{
+  HDStatusTimerPrivate *priv = timer->priv;
+  GList *l;
+
+  for (l = priv->subscriptions; l; )
+    {
+      HDStatusTimerSubscription *sub = l->data;
+      GList *next = l->next;
+
+      if (sub->removed)
+        {
+          subscription_free (sub);
+          priv->subscriptions = g_list_delete_link (priv->subscriptions, l);
+        }
+
+      l = next;
+    }
+}
+
+static gboolean
+dispatch_cb (HDStatusTimer *timer)
+{
+  HDStatusTimerPrivate *priv = timer->priv;
+  gint64 now;
+  GList *l;
+
+  priv->source_id = 0;
+
+  g_object_ref (timer);
+
+  now = hd_time_get_monotonic_ms ();
+
+  /* Call everything which may run now, not only the subscription
+   * whose slack ran out */
+  priv->dispatching = TRUE;
+  for (l = priv->subscriptions; l; l = l->next)
+    {
+      HDStatusTimerSubscription *sub = l->data;
+      HDPluginStats *stats;
+      gint64 start;
+
+      if (sub->removed || sub->due > now)
+        continue;
+
+      sub->due = now + sub->period;
+
+      /* Subscriptions with a plugin as data are accounted to it */
+      stats = hd_plugin_stats_lookup (sub->data);
+      start = hd_plugin_stats_begin (stats);
+
+      if (!sub->func (sub->data))
+        sub->removed = TRUE;
+
+      hd_plugin_stats_end (stats, start);
+    }
+  priv->dispatching = FALSE;
+
+  sweep_removed (timer);
+  schedule (timer);
+
+  g_object_unref (timer);
+
+  return FALSE;
+}
+
+static void
+schedule (HDStatusTimer *timer)
+{
+  HDStatusTimerPrivate *priv = timer->priv;
+  HDStatusTimerSubscription *first = NULL;
+  gint64 deadline = G_MAXINT64, aligned, now;
+  GList *l;
+
+  if (priv->paused || priv->dispatching)
+    return;
+
+  /* The next wakeup is when the first subscription runs out of slack */
+  for (l = priv->subscriptions; l; l = l->next)
+    {
+      HDStatusTimerSubscription *sub = l->data;
+
+      if (!sub->removed && sub->due + sub->slack < deadline)
+        {
+          deadline = sub->due + sub->slack;
+          first = sub;
+        }
+    }
+
+  if (!first)
+    {
+      if (priv->source_id)
+        {
+          g_source_remove (priv->source_id);
+          priv->source_id = 0;
+        }
+      return;
+    }
+
+  /* Use the common tick if it is inside the window of the subscription */
+  aligned = deadline - deadline % TICK_ALIGNMENT;
+  if (aligned >= first->due)
+    deadline = aligned;
+
+  if (priv->source_id && priv->deadline == deadline)
+    return;
+
+  if (priv->source_id)
+    g_source_remove (priv->source_id);
+
+  now = hd_time_get_monotonic_ms ();
+  priv->deadline = deadline;
+  priv->source_id = g_timeout_add (deadline > now ? deadline - now : 0,
+                                   (GSourceFunc) dispatch_cb,
+                                   timer);
+}
+
+HDStatusTimer *
+hd_status_timer_new (void)
+{
+  return g_object_new (HD_TYPE_STATUS_TIMER, NULL);
+}
+
+/**
+ * hd_status_timer_add:
+ * @timer: the #HDStatusTimer
+ * @period: the minimum time between calls in milliseconds
+ * @slack: how much later the call may happen in milliseconds
+ * @func: called when the period expired, return %FALSE to unsubscribe
+ * @data: data passed to @func
+ *
+ * Subscribes @func to the timer service. Calls of all subscriptions are
+ * merged onto common ticks as far as their slack allows, and stop while
+ * the timer is paused. Overdue subscriptions are called once when the
+ * timer is resumed.
+ *
+ * Returns: the id of the subscription
+ **/
+guint
+hd_status_timer_add (HDStatusTimer *timer,
+                     guint          period,
+                     guint          slack,
+                     GSourceFunc    func,
+                     gpointer       data)
+{
+  HDStatusTimerPrivate *priv;
+  HDStatusTimerSubscription *sub;
+
+  g_return_val_if_fail (HD_IS_STATUS_TIMER (timer), 0);
+  g_return_val_if_fail (func != NULL, 0);
+
+  priv = timer->priv;
+
+  sub = g_slice_new0 (HDStatusTimerSubscription);
+  sub->id = ++priv->last_id;
+  sub->period = period;
+  sub->slack = slack;
+  sub->func = func;
+  sub->data = data;
+  sub->due = hd_time_get_monotonic_ms () + period;
+
+  priv->subscriptions = g_list_prepend (priv->subscriptions, sub);
+
+  schedule (timer);
+
+  return sub->id;
+}
+
+void
+hd_status_timer_remove (HDStatusTimer *timer,
+                        guint          id)
+{
+  HDStatusTimerPrivate *priv;
+  GList *l;
+
+  g_return_if_fail (HD_IS_STATUS_TIMER (timer));
+
+  priv = timer->priv;
+
+  for (l = priv->subscriptions; l; l = l->next)
+    {
+      HDStatusTimerSubscription *sub = l->data;
+
+      if (sub->id == id)
+        {
+          sub->removed = TRUE;
+          break;
+        }
+    }
+
+  if (!priv->dispatching)
+    {
+      sweep_removed (timer);
+      schedule (timer);
+    }
+}
+
+/**
+ * hd_status_timer_set_paused:
+ * @timer: the #HDStatusTimer
+ * @paused: whether the timer should be paused
+ *
+ * Stops all wakeups of the timer service while the status area is not
+ * visible. On resume overdue subscriptions are called and
+ * #HDStatusTimer::minute-changed is emitted, as the minute may have
+ * changed in between.
+ **/
+void
+hd_status_timer_set_paused (HDStatusTimer *timer,
+                            gboolean       paused)
+{
+  HDStatusTimerPrivate *priv;
+
+  g_return_if_fail (HD_IS_STATUS_TIMER (timer));
+
+  priv = timer->priv;
+  paused = paused != FALSE;
+
+  if (priv->paused == paused)
+    return;
+
+  priv->paused = paused;
+
+  if (paused)
+    {
+      if (priv->source_id)
+        {
+          g_source_remove (priv->source_id);
+          priv->source_id = 0;
+        }
+      disarm_minute_timer (timer);
+    }
+  else
+    {
+      arm_minute_timer (timer);
+      emit_minute_changed (timer);
+      schedule (timer);
+    }
+}
+
+/**
+ * hd_status_timer_get_wakeup_rate:
+ * @timer: the #HDStatusTimer
+ *
+ * Returns: the main loop wakeups per second of the process, measured
+ * between the last two minute ticks
+ **/
+gdouble
+hd_status_timer_get_wakeup_rate (HDStatusTimer *timer)
+{
+  g_return_val_if_fail (HD_IS_STATUS_TIMER (timer), 0.0);
+
+  return wakeup_rate;
+}
+
+/**
+ * hd_status_timer_dump_wakeups:
+ * @file: where to write the statistics
+ *
+ * Writes the main loop wakeups of the process since the first timer was
+ * created, with their average rate and the rate between the last two
+ * minute ticks.
+ **/
+void
+hd_status_timer_dump_wakeups (FILE *file)
+{
+  gint64 ms = hd_time_get_monotonic_ms () - wakeups_since;
+
+  fprintf (file, "%-24s %12s %10s %14s %14s\n",
+           "main loop", "wakeups", "seconds", "per_second", "last_minute");
+  fprintf (file, "%-24s %12" G_GUINT64_FORMAT " %10.1f %14.2f %14.2f\n",
+           "process",
+           wakeups,
+           ms / 1000.0,
+           ms > 0 ? wakeups * 1000.0 / ms : 0.0,
+           wakeup_rate);
+}
@@ -0,0 +1,112 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_STATUS_TIMER_H__
+#define __HD_STATUS_TIMER_H__
+
+#include <glib-object.h>
+
+#include <stdio.h>
+
+G_BEGIN_DECLS
+
+#define HD_TYPE_STATUS_TIMER            (hd_status_timer_get_type ())
+#define HD_STATUS_TIMER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), HD_TYPE_STATUS_TIMER, HDStatusTimer))
+#define HD_STATUS_TIMER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), HD_TYPE_STATUS_TIMER, HDStatusTimerClass))
+#define HD_IS_STATUS_TIMER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), HD_TYPE_STATUS_TIMER))
+#define HD_IS_STATUS_TIMER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), HD_TYPE_STATUS_TIMER))
+#define HD_STATUS_TIMER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), HD_TYPE_STATUS_TIMER, HDStatusTimerClass))
+
+/* Status plugins find the timer service of the status area as object
+ * data under this key */
+#define HD_STATUS_TIMER_KEY "status-area-timer"
+
+typedef struct _HDStatusTimer        HDStatusTimer;
+typedef struct _HDStatusTimerClass   HDStatusTimerClass;
+typedef struct _HDStatusTimerPrivate HDStatusTimerPrivate;
+
+typedef struct _HDStatusTimerRequest HDStatusTimerRequest;
+
+/**
+ * HDStatusTimerRequest:
+ * @period: the minimum time between two calls in milliseconds
+ * @slack: how much later than @period the call may happen
+ * @func: called when the period expired, return %FALSE to unsubscribe
+ * @data: passed to @func
+ * @id: filled in with the id of the subscription
+ *
+ * Passed to the "add-timeout" action signal by plugins, which are not
+ * linked against the status menu:
+ *
+ * |[
+ * HDStatusTimerRequest request = { 10000, 5000, update_cb, plugin, 0 };
+ * g_signal_emit_by_name (timer, "add-timeout", &request);
+ * ]|
+ */
+struct _HDStatusTimerRequest
+{
+  guint       period;
+  guint       slack;
+  GSourceFunc func;
+  gpointer    data;
+
+  guint       id;
+};
+
+struct _HDStatusTimer
+{
+  GObject parent;
+
+  HDStatusTimerPrivate *priv;
+};
+
+struct _HDStatusTimerClass
+{
+  GObjectClass parent;
+
+  /* action signals */
+  void (*add_timeout)    (HDStatusTimer        *timer,
+                          HDStatusTimerRequest *request);
+  void (*remove_timeout) (HDStatusTimer        *timer,
+                          guint                 id);
+};
+
+GType          hd_status_timer_get_type        (void);
+
+HDStatusTimer *hd_status_timer_new             (void);
+
+guint          hd_status_timer_add             (HDStatusTimer *timer,
+                                                guint          period,
+                                                guint          slack,
+                                                GSourceFunc    func,
+                                                gpointer       data);
+void           hd_status_timer_remove          (HDStatusTimer *timer,
+                                                guint          id);
+
+void           hd_status_timer_set_paused      (HDStatusTimer *timer,
+                                                gboolean       paused);
+
+gdouble        hd_status_timer_get_wakeup_rate (HDStatusTimer *timer);
+void           hd_status_timer_dump_wakeups    (FILE          *file);
+
+G_END_DECLS
+
+#endif
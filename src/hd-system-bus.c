@@ -0,0 +1,462 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "hd-metrics.h"
+#include "hd-probes.h"
+#include "hd-system-bus.h"
+#include "hd-time.h"
+
+#define HD_SYSTEM_BUS_GET_PRIVATE(object) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((object), HD_TYPE_SYSTEM_BUS, HDSystemBusPrivate))
+
+#define MATCH_RULE "type='signal',interface='%s',member='%s'"
+
+struct _HDSystemBusPrivate
+{
+  DBusConnection *connection;
+
+  /* HDSystemBusMatch -> HDSystemBusMatch, one per interface/member */
+  GHashTable *matches;
+
+  /* handler id -> HDSystemBusMatch */
+  GHashTable *handler_matches;
+  guint last_handler_id;
+
+  /* signals which reached the filter without a handler */
+  guint64 unmatched;
+};
+
+typedef struct _HDSystemBusHandler HDSystemBusHandler;
+struct _HDSystemBusHandler
+{
+  guint                 id;
+  HDSystemBusSignalFunc func;
+  gpointer              data;
+};
+
+typedef struct _HDSystemBusMatch HDSystemBusMatch;
+struct _HDSystemBusMatch
+{
+  gchar  *interface;
+  gchar  *member;
+  gchar  *rule;
+
+  GSList *handlers;
+
+  /* nesting of dispatches, handlers removed meanwhile are only marked */
+  guint   dispatching;
+  guint   removed_handlers : 1;
+
+  /* dispatch statistics */
+  guint64 dispatches;
+  guint64 total_us;
+  guint64 max_us;
+};
+
+static void hd_system_bus_dispose (GObject *object);
+
+static DBusHandlerResult system_bus_signal_filter (DBusConnection *connection,
+                                                   DBusMessage    *message,
+                                                   void           *data);
+
+G_DEFINE_TYPE (HDSystemBus, hd_system_bus, G_TYPE_OBJECT);
+
+HDSystemBus *
+hd_system_bus_get (void)
+{
+  static gpointer bus = NULL;
+
+  if (bus == NULL)
+    {
+      bus = g_object_new (HD_TYPE_SYSTEM_BUS,
+                          NULL);
+      g_object_add_weak_pointer (bus, &bus);
+      return bus;
+    }
+  else
+    {
+      return g_object_ref (bus);
+    }
+}
+
+static guint
+match_hash (gconstpointer key)
+{
+  const HDSystemBusMatch *match = key;
+
+  return g_str_hash (match->interface) * 31 + g_str_hash (match->member);
+}
+
+static gboolean
+match_equal (gconstpointer a,
+             gconstpointer b)
+{
+  const HDSystemBusMatch *match_a = a, *match_b = b;
+
+  return strcmp (match_a->member, match_b->member) == 0 &&
+         strcmp (match_a->interface, match_b->interface) == 0;
+}
+
+static void
+match_free (HDSystemBusMatch *match)
+{
+  g_slist_foreach (match->handlers, (GFunc) g_free, NULL);
+  g_slist_free (match->handlers);
+  g_free (match->interface);
+  g_free (match->member);
+  g_free (match->rule);
+  g_slice_free (HDSystemBusMatch, match);
+}
+
+static void
+hd_system_bus_class_init (HDSystemBusClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = hd_system_bus_dispose;
+
+  g_type_class_add_private (klass, sizeof (HDSystemBusPrivate));
+}
+
+static void
+hd_system_bus_init (HDSystemBus *bus)
+{
+  HDSystemBusPrivate *priv;
+  DBusError error;
+
+  bus->priv = priv = HD_SYSTEM_BUS_GET_PRIVATE (bus);
+
+  priv->matches = g_hash_table_new_full (match_hash,
+                                         match_equal,
+                                         NULL,
+                                         (GDestroyNotify) match_free);
+  priv->handler_matches = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  dbus_error_init (&error);
+  priv->connection = dbus_bus_get (DBUS_BUS_SYSTEM,
+                                   &error);
+  if (dbus_error_is_set (&error))
+    {
+      g_warning ("%s. Could not connect to System D-Bus. %s",
+                 __FUNCTION__,
+                 error.message);
+      dbus_error_free (&error);
+      priv->connection = NULL;
+      return;
+    }
+
+  /* One filter for all system bus signals of the process */
+  dbus_connection_add_filter (priv->connection,
+                              system_bus_signal_filter,
+                              bus,
+                              NULL);
+}
+
+/* Unsubscribes from the signal when the last handler is gone */
+static void
+remove_match_if_unused (HDSystemBus      *bus,
+                        HDSystemBusMatch *match)
+{
+  HDSystemBusPrivate *priv = bus->priv;
+
+  if (match->handlers)
+    return;
+
+  if (priv->connection)
+    dbus_bus_remove_match (priv->connection, match->rule, NULL);
+  g_hash_table_remove (priv->matches, match);
+}
+
+static void
+remove_marked_handlers (HDSystemBus      *bus,
+                        HDSystemBusMatch *match)
+{
+  GSList *h;
+
+  for (h = match->handlers; h; )
+    {
+      GSList *next = h->next;
+      HDSystemBusHandler *handler = h->data;
+
+      if (!handler->func)
+        {
+          match->handlers = g_slist_delete_link (match->handlers, h);
+          g_free (handler);
+        }
+
+      h = next;
+    }
+  match->removed_handlers = FALSE;
+
+  remove_match_if_unused (bus, match);
+}
+
+static DBusHandlerResult
+system_bus_signal_filter (DBusConnection *connection,
+                          DBusMessage    *message,
+                          void           *data)
+{
+  HDSystemBus *bus = data;
+  HDSystemBusPrivate *priv = bus->priv;
+  HDSystemBusMatch key, *match;
+  guint64 start, elapsed;
+  GSList *handlers, *h;
+
+  if (dbus_message_get_type (message) != DBUS_MESSAGE_TYPE_SIGNAL)
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  key.interface = (gchar *) dbus_message_get_interface (message);
+  key.member = (gchar *) dbus_message_get_member (message);
+  if (!key.interface || !key.member)
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  HD_PROBE2 (dbus__signal, key.interface, key.member);
+
+  match = g_hash_table_lookup (priv->matches, &key);
+  if (!match)
+    {
+      priv->unmatched++;
+      return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
+  start = hd_time_get_monotonic_us ();
+
+  /* Handlers may add or remove any handler, also the last one of the
+   * match. The match and the removed handlers are kept until the
+   * dispatch is over, handlers added meanwhile get the next signal */
+  g_object_ref (bus);
+  match->dispatching++;
+
+  handlers = g_slist_copy (match->handlers);
+  for (h = handlers; h; h = h->next)
+    {
+      HDSystemBusHandler *handler = h->data;
+
+      if (handler->func)
+        handler->func (message, handler->data);
+    }
+  g_slist_free (handlers);
+
+  match->dispatching--;
+
+  elapsed = hd_time_get_monotonic_us () - start;
+  match->dispatches++;
+  match->total_us += elapsed;
+  match->max_us = MAX (match->max_us, elapsed);
+  HD_METRICS_OBSERVE ("dbus-dispatch", elapsed);
+
+  if (!match->dispatching && match->removed_handlers)
+    remove_marked_handlers (bus, match);
+
+  g_object_unref (bus);
+
+  /* Other filters on the shared connection may want the signal too */
+  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+static void
+hd_system_bus_dispose (GObject *object)
+{
+  HDSystemBusPrivate *priv = HD_SYSTEM_BUS (object)->priv;
+
+  if (priv->connection)
+    {
+      GHashTableIter iter;
+      gpointer key;
+
+      g_hash_table_iter_init (&iter, priv->matches);
+      while (g_hash_table_iter_next (&iter, &key, NULL))
+        dbus_bus_remove_match (priv->connection,
+                               ((HDSystemBusMatch *) key)->rule,
+                               NULL);
+
+      dbus_connection_remove_filter (priv->connection,
+                                     system_bus_signal_filter,
+                                     object);
+      priv->connection = NULL;
+    }
+
+  if (priv->handler_matches)
+    priv->handler_matches = (g_hash_table_destroy (priv->handler_matches), NULL);
+
+  if (priv->matches)
+    priv->matches = (g_hash_table_destroy (priv->matches), NULL);
+
+  G_OBJECT_CLASS (hd_system_bus_parent_class)->dispose (object);
+}
+
+DBusConnection *
+hd_system_bus_get_connection (HDSystemBus *bus)
+{
+  g_return_val_if_fail (HD_IS_SYSTEM_BUS (bus), NULL);
+
+  return bus->priv->connection;
+}
+
+/**
+ * hd_system_bus_add_signal_handler:
+ * @bus: the #HDSystemBus
+ * @interface: the signal interface
+ * @member: the signal name
+ * @func: called with the signal message
+ * @data: data passed to @func
+ *
+ * Subscribes to a single system bus signal with a match rule on both
+ * interface and member, so the process is not woken up for other
+ * signals of the interface.
+ *
+ * Returns: the handler id or 0 if there is no system bus
+ **/
+guint
+hd_system_bus_add_signal_handler (HDSystemBus           *bus,
+                                  const gchar           *interface,
+                                  const gchar           *member,
+                                  HDSystemBusSignalFunc  func,
+                                  gpointer               data)
+{
+  HDSystemBusPrivate *priv;
+  HDSystemBusMatch key, *match;
+  HDSystemBusHandler *handler;
+
+  g_return_val_if_fail (HD_IS_SYSTEM_BUS (bus), 0);
+  g_return_val_if_fail (interface != NULL && member != NULL && func != NULL, 0);
+
+  priv = bus->priv;
+
+  if (!priv->connection)
+    return 0;
+
+  key.interface = (gchar *) interface;
+  key.member = (gchar *) member;
+
+  match = g_hash_table_lookup (priv->matches, &key);
+  if (!match)
+    {
+      match = g_slice_new0 (HDSystemBusMatch);
+      match->interface = g_strdup (interface);
+      match->member = g_strdup (member);
+      match->rule = g_strdup_printf (MATCH_RULE, interface, member);
+
+      dbus_bus_add_match (priv->connection, match->rule, NULL);
+
+      g_hash_table_insert (priv->matches, match, match);
+    }
+
+  handler = g_new0 (HDSystemBusHandler, 1);
+  handler->id = ++priv->last_handler_id;
+  handler->func = func;
+  handler->data = data;
+
+  match->handlers = g_slist_append (match->handlers, handler);
+  g_hash_table_insert (priv->handler_matches,
+                       GUINT_TO_POINTER (handler->id),
+                       match);
+
+  return handler->id;
+}
+
+void
+hd_system_bus_remove_signal_handler (HDSystemBus *bus,
+                                     guint        handler_id)
+{
+  HDSystemBusPrivate *priv;
+  HDSystemBusMatch *match;
+  GSList *h;
+
+  g_return_if_fail (HD_IS_SYSTEM_BUS (bus));
+
+  priv = bus->priv;
+
+  if (!priv->handler_matches)
+    return;
+
+  match = g_hash_table_lookup (priv->handler_matches,
+                               GUINT_TO_POINTER (handler_id));
+  if (!match)
+    return;
+
+  g_hash_table_remove (priv->handler_matches,
+                       GUINT_TO_POINTER (handler_id));
+
+  for (h = match->handlers; h; h = h->next)
+    {
+      HDSystemBusHandler *handler = h->data;
+
+      if (handler->id == handler_id)
+        {
+          /* Freed when the dispatch of the match is over */
+          if (match->dispatching)
+            {
+              handler->func = NULL;
+              match->removed_handlers = TRUE;
+              return;
+            }
+
+          match->handlers = g_slist_delete_link (match->handlers, h);
+          g_free (handler);
+          break;
+        }
+    }
+
+  remove_match_if_unused (bus, match);
+}
+
+/**
+ * hd_system_bus_dump_stats:
+ * @bus: the #HDSystemBus
+ * @file: where to write the statistics
+ *
+ * Writes the number of dispatches and the time spent in the handlers of
+ * every subscribed signal.
+ **/
+void
+hd_system_bus_dump_stats (HDSystemBus *bus,
+                          FILE        *file)
+{
+  HDSystemBusPrivate *priv;
+  GHashTableIter iter;
+  gpointer key;
+
+  g_return_if_fail (HD_IS_SYSTEM_BUS (bus));
+
+  priv = bus->priv;
+
+  fprintf (file, "%-40s %-24s %10s %12s %10s\n",
+           "interface", "member", "dispatches", "total_us", "max_us");
+
+  g_hash_table_iter_init (&iter, priv->matches);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      HDSystemBusMatch *match = key;
+
+      fprintf (file, "%-40s %-24s %10" G_GUINT64_FORMAT " %12" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT "\n",
+               match->interface, match->member,
+               match->dispatches, match->total_us, match->max_us);
+    }
+
+  fprintf (file, "unmatched signals: %" G_GUINT64_FORMAT "\n", priv->unmatched);
+}
@@ -0,0 +1,77 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_SYSTEM_BUS_H__
+#define __HD_SYSTEM_BUS_H__
+
+#include <glib-object.h>
+#include <dbus/dbus.h>
+
+#include <stdio.h>
+
+G_BEGIN_DECLS
+
+#define HD_TYPE_SYSTEM_BUS            (hd_system_bus_get_type ())
+#define HD_SYSTEM_BUS(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), HD_TYPE_SYSTEM_BUS, HDSystemBus))
+#define HD_SYSTEM_BUS_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), HD_TYPE_SYSTEM_BUS, HDSystemBusClass))
+#define HD_IS_SYSTEM_BUS(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), HD_TYPE_SYSTEM_BUS))
+#define HD_IS_SYSTEM_BUS_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), HD_TYPE_SYSTEM_BUS))
+#define HD_SYSTEM_BUS_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), HD_TYPE_SYSTEM_BUS, HDSystemBusClass))
+
+typedef struct _HDSystemBus        HDSystemBus;
+typedef struct _HDSystemBusClass   HDSystemBusClass;
+typedef struct _HDSystemBusPrivate HDSystemBusPrivate;
+
+typedef void (*HDSystemBusSignalFunc) (DBusMessage *message,
+                                       gpointer     data);
+
+struct _HDSystemBus
+{
+  GObject parent;
+
+  HDSystemBusPrivate *priv;
+};
+
+struct _HDSystemBusClass
+{
+  GObjectClass parent;
+};
+
+GType           hd_system_bus_get_type              (void);
+
+HDSystemBus    *hd_system_bus_get                   (void);
+
+DBusConnection *hd_system_bus_get_connection        (HDSystemBus           *bus);
+
+guint           hd_system_bus_add_signal_handler    (HDSystemBus           *bus,
+                                                     const gchar           *interface,
+                                                     const gchar           *member,
+                                                     HDSystemBusSignalFunc  func,
+                                                     gpointer               data);
+void            hd_system_bus_remove_signal_handler (HDSystemBus           *bus,
+                                                     guint                  handler_id);
+
+void            hd_system_bus_dump_stats            (HDSystemBus           *bus,
+                                                     FILE                  *file);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,305 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+/* Consumer of the -finstrument-functions hooks of --enable-instrumenting.
+ *
+ * Every function entry and exit is stored with a timestamp in a ring
+ * buffer of the calling thread. Only the owning thread writes to a
+ * ring, so recording needs neither locks nor atomic operations; rings
+ * are registered with a compare and swap on first use. Addresses are
+ * only resolved to symbols when the trace is written, as Chrome trace
+ * event JSON which chrome://tracing and Perfetto load.
+ *
+ * Nothing in this file may be instrumented itself. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hd-trace.h"
+
+#define NO_INSTRUMENT __attribute__ ((no_instrument_function))
+
+/* Events kept per thread, a power of two */
+#define RING_SIZE (1 << 16)
+#define RING_MASK (RING_SIZE - 1)
+
+typedef struct _HDTraceEvent HDTraceEvent;
+typedef struct _HDTraceRing  HDTraceRing;
+
+struct _HDTraceEvent
+{
+  guint64  time_ns;
+  gpointer fn;
+  gboolean exit;
+};
+
+struct _HDTraceRing
+{
+  HDTraceRing  *next;
+  pid_t         tid;
+
+  gsize         head;
+  gboolean      wrapped;
+  HDTraceEvent  events[RING_SIZE];
+};
+
+static gboolean enabled = FALSE;
+
+/* All rings, pushed with a compare and swap and never freed, so a dump
+ * can walk them while other threads record */
+static HDTraceRing *rings = NULL;
+
+static __thread HDTraceRing *thread_ring = NULL;
+
+/* Set while the hooks run, allocators may be instrumented */
+static __thread gboolean in_hook = FALSE;
+
+void __cyg_profile_func_enter (void *fn, void *call_site) NO_INSTRUMENT;
+void __cyg_profile_func_exit  (void *fn, void *call_site) NO_INSTRUMENT;
+
+static HDTraceRing *
+create_ring (void) NO_INSTRUMENT;
+static HDTraceRing *
+create_ring (void)
+{
+  HDTraceRing *ring = calloc (1, sizeof (HDTraceRing));
+
+  if (!ring)
+    return NULL;
+
+  ring->tid = syscall (SYS_gettid);
+
+  do
+    ring->next = g_atomic_pointer_get ((gpointer *) &rings);
+  while (!g_atomic_pointer_compare_and_exchange ((gpointer *) &rings,
+                                                 ring->next, ring));
+
+  return ring;
+}
+
+static inline void
+record (gpointer fn,
+        gboolean exit) NO_INSTRUMENT;
+static inline void
+record (gpointer fn,
+        gboolean exit)
+{
+  HDTraceRing *ring;
+  HDTraceEvent *event;
+  struct timespec ts;
+
+  if (G_LIKELY (!enabled) || in_hook)
+    return;
+
+  in_hook = TRUE;
+
+  ring = thread_ring;
+  if (G_UNLIKELY (!ring))
+    ring = thread_ring = create_ring ();
+
+  if (G_LIKELY (ring))
+    {
+      clock_gettime (CLOCK_MONOTONIC, &ts);
+
+      event = &ring->events[ring->head & RING_MASK];
+      event->time_ns = (guint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+      event->fn = fn;
+      event->exit = exit;
+
+      if ((ring->head & RING_MASK) == RING_MASK)
+        ring->wrapped = TRUE;
+      ring->head++;
+    }
+
+  in_hook = FALSE;
+}
+
+void
+__cyg_profile_func_enter (void *fn,
+                          void *call_site)
+{
+  record (fn, FALSE);
+}
+
+void
+__cyg_profile_func_exit (void *fn,
+                         void *call_site)
+{
+  record (fn, TRUE);
+}
+
+/**
+ * hd_trace_init:
+ *
+ * Starts recording if %HD_TRACE_ENV is set.
+ **/
+void
+hd_trace_init (void) NO_INSTRUMENT;
+void
+hd_trace_init (void)
+{
+  if (g_getenv (HD_TRACE_ENV))
+    enabled = TRUE;
+}
+
+/* Functions in shared objects are resolved with dladdr (), static ones
+ * and the executable without -export-dynamic are written as
+ * object+offset for addr2line */
+static const gchar *
+resolve (GHashTable *symbols,
+         gpointer    fn) NO_INSTRUMENT;
+static const gchar *
+resolve (GHashTable *symbols,
+         gpointer    fn)
+{
+  gchar *name = g_hash_table_lookup (symbols, fn);
+  Dl_info info;
+
+  if (name)
+    return name;
+
+  memset (&info, 0, sizeof (info));
+
+  if (dladdr (fn, &info) && info.dli_sname && info.dli_saddr == fn)
+    name = g_strdup (info.dli_sname);
+  else if (info.dli_fname)
+    name = g_strdup_printf ("%s+0x%lx",
+                            info.dli_fname,
+                            (gulong) ((gchar *) fn - (gchar *) info.dli_fbase));
+  else
+    name = g_strdup_printf ("%p", fn);
+
+  g_hash_table_insert (symbols, fn, name);
+
+  return name;
+}
+
+static gboolean
+write_ring (HDTraceRing *ring,
+            GHashTable  *symbols,
+            FILE        *file,
+            gboolean     first) NO_INSTRUMENT;
+static gboolean
+write_ring (HDTraceRing *ring,
+            GHashTable  *symbols,
+            FILE        *file,
+            gboolean     first)
+{
+  gsize head = ring->head, i, start;
+  guint depth = 0;
+  pid_t pid = getpid ();
+
+  /* The oldest events may be overwritten while they are written */
+  start = ring->wrapped ? head - RING_SIZE : 0;
+
+  for (i = start; i < head; i++)
+    {
+      HDTraceEvent *event = &ring->events[i & RING_MASK];
+
+      /* Exits whose entry was overwritten */
+      if (event->exit && !depth)
+        continue;
+
+      if (event->exit)
+        depth--;
+      else
+        depth++;
+
+      fprintf (file,
+               "%s{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%" G_GUINT64_FORMAT ".%03u,"
+               "\"pid\":%d,\"tid\":%d}",
+               first ? "" : ",\n",
+               resolve (symbols, event->fn),
+               event->exit ? "E" : "B",
+               event->time_ns / 1000,
+               (guint) (event->time_ns % 1000),
+               pid,
+               ring->tid);
+
+      first = FALSE;
+    }
+
+  return first;
+}
+
+/**
+ * hd_trace_dump:
+ * @filename: the file to write
+ *
+ * Writes the recorded events of all threads to @filename. Recording
+ * is paused for the calling thread only.
+ *
+ * Returns: %TRUE if the trace was written
+ **/
+gboolean
+hd_trace_dump (const gchar *filename) NO_INSTRUMENT;
+gboolean
+hd_trace_dump (const gchar *filename)
+{
+  GHashTable *symbols;
+  HDTraceRing *ring;
+  gboolean first = TRUE;
+  FILE *file;
+
+  if (!enabled)
+    return FALSE;
+
+  file = fopen (filename, "w");
+  if (!file)
+    {
+      g_warning ("%s. Could not open %s. %s",
+                 __FUNCTION__,
+                 filename,
+                 g_strerror (errno));
+      return FALSE;
+    }
+
+  in_hook = TRUE;
+
+  symbols = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                   NULL, g_free);
+
+  fprintf (file, "{\"traceEvents\":[\n");
+  for (ring = g_atomic_pointer_get ((gpointer *) &rings); ring; ring = ring->next)
+    first = write_ring (ring, symbols, file, first);
+  fprintf (file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+
+  g_hash_table_destroy (symbols);
+
+  in_hook = FALSE;
+
+  return fclose (file) == 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gdk/gdkx.h>
+
+#include "hd-flight-recorder.h"
+#include "hd-x-stats.h"
+
+/* path -> HDXStats, paths are static strings */
+static GHashTable *stats_table = NULL;
+
+static Display *
+get_xdisplay (void)
+{
+  GdkDisplay *display = gdk_display_get_default ();
+
+  return display ? GDK_DISPLAY_XDISPLAY (display) : NULL;
+}
+
+/**
+ * hd_x_stats_begin:
+ * @section: a section on the stack
+ *
+ * Starts counting the X requests of a code path, which is ended with
+ * hd_x_stats_end().
+ **/
+void
+hd_x_stats_begin (HDXStatsSection *section)
+{
+  Display *xdisplay = get_xdisplay ();
+
+  section->next_request = xdisplay ? NextRequest (xdisplay) : 0;
+}
+
+/**
+ * hd_x_stats_end:
+ * @section: the section passed to hd_x_stats_begin()
+ * @path: name of the code path, a static string
+ *
+ * Adds the requests sent since hd_x_stats_begin() to @path. When the
+ * server processed one of them before the section ended, the code
+ * blocked on a reply and a round trip is counted. Several replies
+ * within one section count as one round trip.
+ **/
+void
+hd_x_stats_end (HDXStatsSection *section,
+                const gchar     *path)
+{
+  Display *xdisplay = get_xdisplay ();
+  HDXStats *stats;
+  gulong requests;
+
+  if (!xdisplay)
+    return;
+
+  if (!stats_table)
+    stats_table = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                         NULL, g_free);
+
+  stats = g_hash_table_lookup (stats_table, path);
+  if (!stats)
+    {
+      stats = g_new0 (HDXStats, 1);
+      g_hash_table_insert (stats_table, (gpointer) path, stats);
+    }
+
+  requests = NextRequest (xdisplay) - section->next_request;
+
+  stats->calls++;
+  stats->requests += requests;
+
+  /* Requests are only known to be processed once a reply, error or
+   * event with a later sequence number was read */
+  if (requests && LastKnownRequestProcessed (xdisplay) >= section->next_request)
+    {
+      stats->round_trips++;
+      hd_flight_recorder_record (HD_FLIGHT_EVENT_X_ROUND_TRIP, 0, requests, path);
+    }
+}
+
+const HDXStats *
+hd_x_stats_lookup (const gchar *path)
+{
+  return stats_table ? g_hash_table_lookup (stats_table, path) : NULL;
+}
+
+/* Sum over all paths */
+void
+hd_x_stats_get_totals (HDXStats *totals)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  totals->calls = 0;
+  totals->requests = 0;
+  totals->round_trips = 0;
+
+  if (!stats_table)
+    return;
+
+  g_hash_table_iter_init (&iter, stats_table);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      HDXStats *stats = value;
+
+      totals->calls += stats->calls;
+      totals->requests += stats->requests;
+      totals->round_trips += stats->round_trips;
+    }
+}
+
+/* Calls @func with the path and its HDXStats */
+void
+hd_x_stats_foreach (GHFunc   func,
+                    gpointer data)
+{
+  if (stats_table)
+    g_hash_table_foreach (stats_table, func, data);
+}
+
+void
+hd_x_stats_reset (void)
+{
+  if (stats_table)
+    g_hash_table_remove_all (stats_table);
+}
+
+static void
+dump_path (gpointer key,
+           gpointer value,
+           gpointer data)
+{
+  HDXStats *stats = value;
+
+  fprintf (data, "%-48s %8u %10lu %11u\n",
+           (const gchar *) key,
+           stats->calls,
+           stats->requests,
+           stats->round_trips);
+}
+
+void
+hd_x_stats_dump (FILE *file)
+{
+  fprintf (file, "%-48s %8s %10s %11s\n",
+           "x path", "calls", "requests", "round_trips");
+
+  hd_x_stats_foreach (dump_path, file);
+}
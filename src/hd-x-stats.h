@@ -0,0 +1,65 @@
+/*
+ * This file is part of hildon-status-menu
+ *
+ * Copyright (C) 2010 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#ifndef __HD_X_STATS_H__
+#define __HD_X_STATS_H__
+
+#include <glib.h>
+
+#include <stdio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _HDXStats        HDXStats;
+typedef struct _HDXStatsSection HDXStatsSection;
+
+/* X traffic of a named code path */
+struct _HDXStats
+{
+  guint  calls;
+  gulong requests;
+
+  /* calls which waited for a reply from the server */
+  guint  round_trips;
+};
+
+/* On the stack of the instrumented code */
+struct _HDXStatsSection
+{
+  gulong next_request;
+};
+
+void            hd_x_stats_begin      (HDXStatsSection *section);
+void            hd_x_stats_end        (HDXStatsSection *section,
+                                       const gchar     *path);
+
+const HDXStats *hd_x_stats_lookup     (const gchar     *path);
+void            hd_x_stats_get_totals (HDXStats        *totals);
+void            hd_x_stats_foreach    (GHFunc           func,
+                                       gpointer         data);
+void            hd_x_stats_reset      (void);
+
+void            hd_x_stats_dump       (FILE            *file);
+
+G_END_DECLS
+
+#endif
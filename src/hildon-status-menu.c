@@ -38,12 +38,27 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#include "hd-flight-recorder.h"
+#include "hd-memory-pressure.h"
+#include "hd-metrics.h"
+#include "hd-plugin-dir-index.h"
+#include "hd-plugin-stats.h"
+#include "hd-signal-dump.h"
 #include "hd-status-area.h"
 #include "hd-status-menu.h"
 #include "hd-status-menu-config.h"
+#include "hd-status-timer.h"
+#include "hd-system-bus.h"
+#ifdef HD_TRACE
+#include "hd-trace.h"
+#endif
 
 #define HD_STAMP_DIR   "/tmp/hildon-desktop/"
 #define HD_STATUS_MENU_STAMP_FILE HD_STAMP_DIR "status-menu.stamp"
+#define HD_STATUS_MENU_PLUGIN_STATS_FILE HD_STAMP_DIR "status-menu-plugin-stats"
+#define HD_STATUS_MENU_DEMOTED_FILE HD_STAMP_DIR "status-menu-demoted-plugins"
+#define HD_STATUS_MENU_FLIGHT_FILE HD_STAMP_DIR "status-menu.flight"
+#define HD_STATUS_MENU_METRICS_FILE HD_STAMP_DIR "status-menu-metrics"
 
 /* signal handler, hildon-desktop sends SIGTERM to all tracked applications
  * when it receives SIGTEM itself */
@@ -58,30 +73,251 @@ load_priority_func (const gchar *plugin_id,
                     GKeyFile    *keyfile,
                     gpointer     data)
 {
-  GError *error = NULL;
-  guint priority = G_MAXUINT;
+  const HDStatusMenuConfigRecord *record;
+
+  record = hd_status_menu_config_lookup (plugin_id);
+
+  /* Plugins which exceeded their quota, also before a restart, are
+   * loaded last */
+  if (hd_plugin_stats_is_demoted (plugin_id))
+    return G_MAXUINT;
 
   /* The permament status area items (clock, signal and
    * battery) should be loaded first (priority == 0) */
-  if (g_key_file_has_key (keyfile,
-                          plugin_id,
-                          HD_STATUS_AREA_CONFIG_KEY_PERMANENT_ITEM,
-                          NULL))
+  if (record->permanent)
     return 0;
 
+  /* Plugins only shown in the Status Menu are not needed until it is
+   * opened, so they are loaded after all status area plugins */
+  if (hd_status_menu_config_is_menu_only (record))
+    return G_MAXUINT - 1;
+
   /* Then the plugins should be loaded regarding to there
-   * position in the status area. */
-  priority = (guint) g_key_file_get_integer (keyfile,
-                                             plugin_id,
-                                             HD_STATUS_AREA_CONFIG_KEY_POSITION,
-                                             &error);
-  if (error == NULL)
-    return priority;
+   * position in the status area. If position is not set,
+   * load last (priority == max) */
+  return record->area_position;
+}
+
+static void
+items_configuration_loaded_cb (HDPluginManager *plugin_manager,
+                               GKeyFile        *keyfile,
+                               gpointer         data)
+{
+  const GSList *c;
+
+  /* Parse the plugin configuration once for all users */
+  hd_status_menu_config_load (keyfile);
+
+  /* Update the quotas of plugins whose configuration changed */
+  for (c = hd_status_menu_config_get_changed (); c; c = c->next)
+    {
+      const HDStatusMenuConfigRecord *record;
+
+      record = hd_status_menu_config_lookup (c->data);
+      hd_plugin_stats_set_quota (c->data,
+                                 record->max_cpu,
+                                 record->max_icon_rate);
+    }
+}
+
+/* Plugins are loaded one after the other while the plugin manager runs,
+ * the load of a plugin ends when it is added. 0 outside of the run */
+static gint64 plugin_load_start = 0;
+
+/* Started in main () to report the startup time */
+static GTimer *startup_timer = NULL;
+
+/* Progress of the plugin load at startup, in the SIGUSR1 dump. Compare
+ * runs with and without HD_STATUS_MENU_EAGER_PLUGINS set */
+typedef struct _HDStartupStage HDStartupStage;
+struct _HDStartupStage
+{
+  guint   plugins;
+  gdouble ms;
+  gulong  rss;
+};
+
+static HDStartupStage area_plugins_loaded = { 0, };
+static HDStartupStage all_plugins_loaded = { 0, };
+
+static void
+record_startup_stage (HDStartupStage *stage,
+                      gdouble         ms,
+                      gulong          rss)
+{
+  stage->plugins++;
+  stage->ms = ms;
+  stage->rss = rss;
+}
+
+static void
+record_plugin_loaded (const HDStatusMenuConfigRecord *record)
+{
+  gdouble ms = g_timer_elapsed (startup_timer, NULL) * 1000.0;
+  gulong rss = hd_memory_pressure_get_rss ();
 
-  /* If position is not set, load last (priority == max) */
-  g_error_free (error);
+  /* Menu only plugins are loaded last, see load_priority_func () */
+  if (!hd_status_menu_config_is_menu_only (record))
+    record_startup_stage (&area_plugins_loaded, ms, rss);
+  record_startup_stage (&all_plugins_loaded, ms, rss);
+}
 
-  return G_MAXUINT;
+static void
+dump_startup (FILE     *file,
+              gpointer  data)
+{
+  fprintf (file, "%-24s %8s %10s %10s\n",
+           g_getenv (HD_STATUS_MENU_EAGER_PLUGINS_ENV) ? "startup (eager)" : "startup",
+           "plugins", "ms", "rss_kb");
+  fprintf (file, "%-24s %8u %10.1f %10lu\n",
+           "status-area-plugins",
+           area_plugins_loaded.plugins,
+           area_plugins_loaded.ms,
+           area_plugins_loaded.rss);
+  fprintf (file, "%-24s %8u %10.1f %10lu\n",
+           "all-plugins",
+           all_plugins_loaded.plugins,
+           all_plugins_loaded.ms,
+           all_plugins_loaded.rss);
+}
+
+static void
+plugin_added_cb (HDPluginManager *plugin_manager,
+                 GObject         *plugin,
+                 gpointer         data)
+{
+  const HDStatusMenuConfigRecord *record;
+  gchar *plugin_id;
+
+  if (plugin_load_start)
+    {
+      HD_METRICS_END ("plugin-load", plugin_load_start);
+      plugin_load_start = hd_metrics_begin ();
+    }
+
+  if (!HD_IS_PLUGIN_ITEM (plugin))
+    return;
+
+  hd_plugin_stats_register (plugin);
+
+  plugin_id = hd_plugin_item_get_plugin_id (HD_PLUGIN_ITEM (plugin));
+  record = hd_status_menu_config_lookup (plugin_id);
+  hd_plugin_stats_set_quota (plugin_id,
+                             record->max_cpu,
+                             record->max_icon_rate);
+  g_free (plugin_id);
+
+  if (startup_timer)
+    record_plugin_loaded (record);
+}
+
+static void
+plugin_removed_cb (HDPluginManager *plugin_manager,
+                   GObject         *plugin,
+                   gpointer         data)
+{
+  hd_plugin_stats_unregister (plugin);
+}
+
+/* TRUE while plugin directory changes from the index are forwarded to the
+ * plugin manager */
+static gboolean forwarding_plugin_modules = FALSE;
+
+static void
+plugin_module_signal_cb (HDPluginManager *plugin_manager,
+                         const gchar     *desktop_file,
+                         gpointer         signal_name)
+{
+  /* Drop the undebounced notifications of the plugin manager's own
+   * directory monitor, the index reports the same changes coalesced */
+  if (!forwarding_plugin_modules)
+    g_signal_stop_emission_by_name (plugin_manager, signal_name);
+}
+
+static void
+forward_plugin_modules (HDPluginManager *plugin_manager,
+                        const gchar     *signal_name,
+                        GSList          *names)
+{
+  GSList *n;
+
+  for (n = names; n; n = n->next)
+    {
+      gchar *desktop_file = g_build_filename (HD_STATUS_MENU_PLUGIN_DIR,
+                                              n->data,
+                                              NULL);
+
+      g_signal_emit_by_name (plugin_manager, signal_name, desktop_file);
+
+      g_free (desktop_file);
+    }
+}
+
+static void
+plugin_dir_changed_cb (HDPluginDirIndex        *index,
+                       HDPluginDirIndexChanges *changes,
+                       HDPluginManager         *plugin_manager)
+{
+  /* Only the touched plugins are unloaded and loaded, changed plugins
+   * are reloaded */
+  forwarding_plugin_modules = TRUE;
+  forward_plugin_modules (plugin_manager, "plugin-module-removed", changes->removed);
+  forward_plugin_modules (plugin_manager, "plugin-module-removed", changes->changed);
+  forward_plugin_modules (plugin_manager, "plugin-module-added", changes->changed);
+  forward_plugin_modules (plugin_manager, "plugin-module-added", changes->added);
+  forwarding_plugin_modules = FALSE;
+}
+
+static gboolean
+can_intercept_signal (HDPluginManager *plugin_manager,
+                      const gchar     *signal_name)
+{
+  GSignalQuery query;
+  guint signal_id;
+
+  signal_id = g_signal_lookup (signal_name, G_OBJECT_TYPE (plugin_manager));
+  if (!signal_id)
+    return FALSE;
+
+  /* The class handler (which does the loading) can only be
+   * prevented if it runs after the user handlers */
+  g_signal_query (signal_id, &query);
+
+  return (query.signal_flags & G_SIGNAL_RUN_LAST) &&
+         !(query.signal_flags & G_SIGNAL_RUN_FIRST);
+}
+
+/* Depends on the HDPluginManager signals "plugin-module-added" and
+ * "plugin-module-removed" of libhildondesktop, emitted with the path of
+ * the desktop file by its own directory monitor, whose G_SIGNAL_RUN_LAST
+ * class handlers load and unload the plugin. The monitor itself keeps
+ * running, only its emissions are replaced by the index's deltas. */
+static HDPluginDirIndex *
+watch_plugin_dir (HDPluginManager *plugin_manager)
+{
+  HDPluginDirIndex *index;
+
+  if (!can_intercept_signal (plugin_manager, "plugin-module-added") ||
+      !can_intercept_signal (plugin_manager, "plugin-module-removed"))
+    {
+      g_warning ("%s. Could not intercept the plugin-module-added and "
+                 "plugin-module-removed signals of %s, the plugin directory "
+                 "is not indexed",
+                 __FUNCTION__,
+                 G_OBJECT_TYPE_NAME (plugin_manager));
+      return NULL;
+    }
+
+  index = hd_plugin_dir_index_new (HD_STATUS_MENU_PLUGIN_DIR);
+
+  g_signal_connect (plugin_manager, "plugin-module-added",
+                    G_CALLBACK (plugin_module_signal_cb), "plugin-module-added");
+  g_signal_connect (plugin_manager, "plugin-module-removed",
+                    G_CALLBACK (plugin_module_signal_cb), "plugin-module-removed");
+  g_signal_connect (index, "changed",
+                    G_CALLBACK (plugin_dir_changed_cb), plugin_manager);
+
+  return index;
 }
 
 static gboolean
@@ -89,11 +325,31 @@ load_plugins_idle (gpointer data)
 {
 
   /* Load the configuration of the plugin manager and load plugins */
+  plugin_load_start = hd_metrics_begin ();
   hd_plugin_manager_run (HD_PLUGIN_MANAGER (data));
+  plugin_load_start = 0;
+
+  /* Plugins loaded later are not part of the startup */
+  g_timer_destroy (startup_timer);
+  startup_timer = NULL;
 
   return FALSE;
 }
 
+static void
+dump_system_bus_stats (FILE        *file,
+                       HDSystemBus *system_bus)
+{
+  hd_system_bus_dump_stats (system_bus, file);
+}
+
+static void
+dump_status_area_redraws (FILE         *file,
+                          HDStatusArea *status_area)
+{
+  hd_status_area_dump_redraws (status_area, file);
+}
+
 static void
 console_quiet(void)
 {
@@ -112,6 +368,15 @@ main (int argc, char **argv)
 {
   GtkWidget *status_area;
   HDPluginManager *plugin_manager;
+  HDPluginDirIndex *plugin_dir_index;
+  HDSystemBus *system_bus;
+
+#ifdef HD_TRACE
+  /* Record function entries and exits, written out at exit */
+  hd_trace_init ();
+#endif
+
+  startup_timer = g_timer_new ();
 
   if (!g_thread_supported ())
     g_thread_init (NULL);
@@ -136,16 +401,47 @@ main (int argc, char **argv)
   /* Setup Stamp File */
   hd_stamp_file_init (HD_STATUS_MENU_STAMP_FILE);
 
+  /* Keep the latest stalls, layouts and round trips in a mapped ring
+   * which survives a crash, decoded with hd-flight-decode */
+  hd_flight_recorder_open (HD_STATUS_MENU_FLIGHT_FILE);
+  hd_flight_recorder_watch_main_loop ();
+
   /* Create a plugin manager instance */
   plugin_manager = hd_plugin_manager_new (
                      hd_config_file_new_with_defaults ("status-menu.conf"));
 
+  /* Connected before the status area and menu, so the parsed
+   * configuration is up to date when they handle the reload */
+  g_signal_connect (plugin_manager, "items-configuration-loaded",
+                    G_CALLBACK (items_configuration_loaded_cb), NULL);
+
+  /* Attribute main loop work to plugins, the table is written on SIGUSR2 */
+  g_signal_connect (plugin_manager, "plugin-added",
+                    G_CALLBACK (plugin_added_cb), NULL);
+  g_signal_connect (plugin_manager, "plugin-removed",
+                    G_CALLBACK (plugin_removed_cb), NULL);
+  hd_plugin_stats_dump_on_signal (SIGUSR2, HD_STATUS_MENU_PLUGIN_STATS_FILE);
+
+  /* Plugins demoted before a restart are loaded last again */
+  hd_plugin_stats_load_demoted (HD_STATUS_MENU_DEMOTED_FILE);
+
+  /* Latency histograms of the hot paths, written on SIGUSR1 */
+  hd_metrics_dump_on_signal (SIGUSR1, HD_STATUS_MENU_METRICS_FILE);
+
+  /* Followed by the cost of every subscribed system bus signal */
+  system_bus = hd_system_bus_get ();
+  hd_signal_dump_add (SIGUSR1, HD_STATUS_MENU_METRICS_FILE,
+                      (HDSignalDumpFunc) dump_system_bus_stats, system_bus);
+
   /* Set the load priority function */
   hd_plugin_manager_set_load_priority_func (plugin_manager,
                                             load_priority_func,
                                             NULL,
                                             NULL);
 
+  /* Report plugin directory changes as debounced per plugin deltas */
+  plugin_dir_index = watch_plugin_dir (plugin_manager);
+
   /* Create simple window to show the Status Menu 
    */
   status_area = hd_status_area_new (plugin_manager);
@@ -153,14 +449,35 @@ main (int argc, char **argv)
   /* Show Status Area */
   gtk_widget_show (status_area);
 
+  /* Icon redraws per display state and main loop wakeups, in the
+   * SIGUSR1 dump */
+  hd_signal_dump_add (SIGUSR1, HD_STATUS_MENU_METRICS_FILE,
+                      (HDSignalDumpFunc) dump_status_area_redraws, status_area);
+  hd_signal_dump_add (SIGUSR1, HD_STATUS_MENU_METRICS_FILE,
+                      (HDSignalDumpFunc) hd_status_timer_dump_wakeups, NULL);
+
+  /* Time and RSS when the plugins were loaded at startup */
+  hd_signal_dump_add (SIGUSR1, HD_STATUS_MENU_METRICS_FILE,
+                      dump_startup, NULL);
+
   /* Load Plugins when idle */
   gdk_threads_add_idle (load_plugins_idle, plugin_manager);
 
   /* Start the main loop */
   gtk_main ();
 
+  if (plugin_dir_index)
+    g_object_unref (plugin_dir_index);
+
+  g_object_unref (system_bus);
+
   /* Delete the stamp file */
   hd_stamp_file_finalize (HD_STATUS_MENU_STAMP_FILE);
 
+#ifdef HD_TRACE
+  if (g_getenv (HD_TRACE_ENV))
+    hd_trace_dump (g_getenv (HD_TRACE_ENV));
+#endif
+
   return 0;
 }